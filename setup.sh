@@ -1,4 +1,4 @@
-sudo apt install build-essential libx11-dev retroarch-dev libsdl2-dev libretro-gtk-1-dev
+sudo apt install build-essential libx11-dev retroarch-dev libsdl2-dev libretro-gtk-1-dev zlib1g-dev
 
 git clone https://github.com/raysan5/raylib.git raylib
 cd ./raylib/src/
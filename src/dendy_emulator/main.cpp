@@ -1,12 +1,56 @@
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <deque>
+#include <map>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <limits>
+#include <cstring>
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <cerrno>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <csignal>
+#include <algorithm>
+#include <dirent.h>
+#include <endian.h>
+#include <netdb.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <zlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 #include <SDL2/SDL.h>
+#define GL_GLEXT_PROTOTYPES // GL 3.3 entry points come straight from libGL
 #include <SDL2/SDL_opengl.h>
 #include "/usr/include/libretro-common/libretro.h"
 
@@ -14,6 +58,8 @@
 SDL_Window *g_window = nullptr;
 SDL_GLContext g_gl_context = nullptr;
 SDL_AudioDeviceID g_audio_device = 0;
+struct retro_audio_callback g_audio_callback = {}; // Set by cores that produce audio on demand
+std::atomic<uint64_t> g_audio_pull_underruns{0};   // Audio callback requests padded with silence
 
 // Libretro function pointers (prefixed with 'core_' to avoid naming collisions)
 void (*core_retro_init)(void);
@@ -24,6 +70,9 @@ void (*core_retro_get_system_av_info)(struct retro_system_av_info *info);
 void (*core_retro_set_controller_port_device)(unsigned port, unsigned device);
 void (*core_retro_reset)(void);
 void (*core_retro_run)(void);
+size_t (*core_retro_serialize_size)(void);
+bool (*core_retro_serialize)(void *data, size_t size);
+bool (*core_retro_unserialize)(const void *data, size_t size);
 bool (*core_retro_load_game)(const struct retro_game_info *game);
 void (*core_retro_unload_game)(void);
 void *(*core_retro_get_memory_data)(unsigned id);
@@ -35,12 +84,48 @@ void (*core_retro_set_input_poll)(retro_input_poll_t);
 void (*core_retro_set_input_state)(retro_input_state_t);
 void (*core_retro_set_environment)(retro_environment_t);
 
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// CPUs for helper threads (logging, capture, disc prefetch). Only set once --realtime
+// has pinned the emulation thread, and then excludes its CPU when there is another.
+cpu_set_t g_helper_cpus;
+std::atomic<bool> g_helper_cpus_set{false};
+
+// Called first on every helper thread. A thread inherits the affinity of the one that
+// started it, which may be the pinned emulation thread.
+static void unpin_helper_thread()
+{
+    if (g_helper_cpus_set.load(std::memory_order_acquire))
+        pthread_setaffinity_np(pthread_self(), sizeof(g_helper_cpus), &g_helper_cpus);
+}
+
 // Application state
 bool g_running = true;
 void *g_core_handle = nullptr;
 int16_t g_keyboard_state[16] = {0}; // State for all possible retro pad buttons for keyboard
 int16_t g_joy_state[16] = {0};      // State for joystick
 SDL_Joystick *g_joystick = nullptr;
+enum retro_pixel_format g_pixel_format = RETRO_PIXEL_FORMAT_0RGB1555; // Libretro default until the core asks otherwise
+const uint64_t g_startup_ns = now_ns();                               // Reference point for startup and log timestamps
+bool g_sandbox = false;                                              // Run the core in a separate host process
+std::vector<uint8_t> g_rom_data;                                     // ROM contents, read ahead of retro_load_game
+uint32_t g_rom_crc = 0;                                              // CRC-32 of g_rom_data, identifies the game
+bool g_resume = true;                                                // Restore the fast-resume state on launch
+volatile sig_atomic_t g_terminate = 0;                               // Set by SIGTERM/SIGINT
+uint64_t g_frame_count = 0;                                          // Frames emulated, including resumed sessions
+
+// Downscaled copy of the last software frame, kept for thumbnails. The core's own
+// buffer is only valid during the video callback, so it is sampled there.
+constexpr unsigned RESUME_THUMB_MAX = 160;                           // Thumbnail fits in RESUME_THUMB_MAX^2
+std::vector<uint8_t> g_thumb_pixels;                                 // Sampled pixels in g_thumb_format
+unsigned g_thumb_width = 0;
+unsigned g_thumb_height = 0;
+enum retro_pixel_format g_thumb_format = RETRO_PIXEL_FORMAT_0RGB1555;
 
 // --- Core Mappings ---
 // Maps file extensions to the name of the libretro core shared library file.
@@ -56,339 +141,4894 @@ const std::unordered_map<std::string, std::string> core_map = {
     {".gen", "genesis_plus_gx_libretro.so"},
     {".gg", "genesis_plus_gx_libretro.so"},
     {".pce", "mednafen_pce_fast_libretro.so"},
+    {".cue", "mednafen_psx_libretro.so"},
+    {".pbp", "mednafen_psx_libretro.so"},
+    {".m3u", "mednafen_psx_libretro.so"},
 };
 
-// --- Libretro Callback Implementations ---
+// --- Core Logging ---
+// Cores log through callback_log, which may run on the emulation thread inside
+// retro_run. It only formats into a thread-local buffer and pushes the record into
+// a bounded lock-free MPSC ring (dropping it if the ring is full); a background
+// thread drains the ring into a rotating log file with a per-level rate limit.
 
-bool callback_environment(unsigned cmd, void *data)
+constexpr size_t LOG_RING_SLOTS = 512; // Power of two
+constexpr size_t LOG_RECORD_BYTES = 512;
+constexpr size_t LOG_FILE_MAX_BYTES = 1024 * 1024;
+constexpr int LOG_FILES_KEPT = 3;                                   // core.log plus core.log.1 .. core.log.2
+constexpr unsigned LOG_RATE_LIMIT[4] = {20, 50, 100, 200};          // Records per second for DEBUG, INFO, WARN, ERROR
+const char *const LOG_LEVEL_NAMES[4] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+struct LogSlot
 {
-    switch (cmd)
+    std::atomic<uint64_t> sequence;
+    unsigned level;
+    uint32_t length;
+    uint64_t timestamp_ns;
+    char text[LOG_RECORD_BYTES];
+};
+
+struct LogRing
+{
+    LogSlot slots[LOG_RING_SLOTS];
+    alignas(64) std::atomic<uint64_t> enqueue_pos{0};
+    alignas(64) uint64_t dequeue_pos = 0; // Only touched by the logger thread
+    std::atomic<uint64_t> dropped{0};
+
+    LogRing()
     {
-    case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+        for (size_t i = 0; i < LOG_RING_SLOTS; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+};
+
+LogRing g_log_ring;
+std::thread g_log_thread;
+std::atomic<bool> g_log_stop{false};
+std::once_flag g_log_started;
+thread_local char g_log_format_buffer[LOG_RECORD_BYTES];
+
+// Bounded MPSC enqueue (Vyukov). Never blocks; returns false when the ring is full.
+static bool log_push(unsigned level, const char *text, size_t length)
+{
+    uint64_t pos = g_log_ring.enqueue_pos.load(std::memory_order_relaxed);
+    LogSlot *slot;
+    for (;;)
     {
-        // auto *cb = (struct retro_log_callback *)data; // Unused
-        // We can redirect core logs to our own console here if desired.
-        // For now, we do nothing.
-        break;
+        slot = &g_log_ring.slots[pos & (LOG_RING_SLOTS - 1)];
+        uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0)
+        {
+            if (g_log_ring.enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = g_log_ring.enqueue_pos.load(std::memory_order_relaxed);
+        }
     }
-    case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+
+    slot->level = level;
+    slot->length = length;
+    slot->timestamp_ns = now_ns();
+    std::memcpy(slot->text, text, length);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void callback_log(enum retro_log_level level, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(g_log_format_buffer, sizeof(g_log_format_buffer), fmt, args);
+    va_end(args);
+    if (length < 0)
+        return;
+
+    unsigned lvl = std::min<unsigned>(level, RETRO_LOG_ERROR);
+    if (!log_push(lvl, g_log_format_buffer, std::min<size_t>(length, LOG_RECORD_BYTES - 1)))
     {
-        *(bool *)data = true;
-        break;
+        g_log_ring.dropped.fetch_add(1, std::memory_order_relaxed);
     }
-    case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+}
+
+static std::string log_directory()
+{
+    const char *home = getenv("HOME");
+    return (std::filesystem::path(home ? home : "/tmp") / ".local/share/dendy/logs").string();
+}
+
+// Shifts core.log -> core.log.1 -> ... and opens a fresh core.log.
+static FILE *rotate_log_file(const std::string &path)
+{
+    for (int i = LOG_FILES_KEPT - 1; i > 0; --i)
     {
-        // auto format = *(enum retro_pixel_format *)data; // Unused
-        // We only support hardware rendering with OpenGL for this simple frontend.
-        // The core will ideally choose RGB565 or XRGB8888.
-        // A more complex frontend would handle different pixel formats.
-        return true; // Return true to indicate we handled this
+        std::string from = i == 1 ? path : path + "." + std::to_string(i - 1);
+        rename(from.c_str(), (path + "." + std::to_string(i)).c_str());
     }
-    default:
-        // Log that we received an unhandled command
+    return fopen(path.c_str(), "w");
+}
+
+void log_thread_main()
+{
+    unpin_helper_thread();
+    std::error_code ec;
+    std::filesystem::create_directories(log_directory(), ec);
+    std::string path = log_directory() + "/core.log";
+    FILE *file = rotate_log_file(path);
+    size_t file_bytes = 0;
+
+    uint64_t window_start = now_ns();
+    unsigned window_count[4] = {0};
+    uint64_t suppressed[4] = {0};
+    uint64_t reported_dropped = 0;
+
+    for (;;)
+    {
+        bool stopping = g_log_stop.load(std::memory_order_acquire);
+        bool wrote = false;
+
+        uint64_t now = now_ns();
+        if (now - window_start >= 1000000000ull)
+        {
+            for (unsigned lvl = 0; lvl < 4; ++lvl)
+            {
+                if (suppressed[lvl] > 0 && file)
+                {
+                    file_bytes += fprintf(file, "[dendy] rate limit: suppressed %llu %s messages\n",
+                                          (unsigned long long)suppressed[lvl], LOG_LEVEL_NAMES[lvl]);
+                    wrote = true;
+                }
+                suppressed[lvl] = 0;
+                window_count[lvl] = 0;
+            }
+            window_start = now;
+        }
+
+        for (;;)
+        {
+            LogSlot &slot = g_log_ring.slots[g_log_ring.dequeue_pos & (LOG_RING_SLOTS - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != g_log_ring.dequeue_pos + 1)
+                break;
+
+            if (window_count[slot.level]++ < LOG_RATE_LIMIT[slot.level])
+            {
+                uint32_t length = slot.length;
+                while (length > 0 && (slot.text[length - 1] == '\n' || slot.text[length - 1] == '\r'))
+                    length--;
+
+                if (file)
+                {
+                    file_bytes += fprintf(file, "[%10.3f] [%s] %.*s\n", (slot.timestamp_ns - g_startup_ns) / 1e9,
+                                          LOG_LEVEL_NAMES[slot.level], (int)length, slot.text);
+                    wrote = true;
+                }
+                if (slot.level >= RETRO_LOG_WARN)
+                {
+                    std::cerr << "[core] " << LOG_LEVEL_NAMES[slot.level] << ": " << std::string(slot.text, length) << std::endl;
+                }
+            }
+            else
+            {
+                suppressed[slot.level]++;
+            }
+
+            slot.sequence.store(g_log_ring.dequeue_pos + LOG_RING_SLOTS, std::memory_order_release);
+            g_log_ring.dequeue_pos++;
+        }
+
+        uint64_t dropped = g_log_ring.dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped && file)
+        {
+            file_bytes += fprintf(file, "[dendy] log ring full: dropped %llu messages\n",
+                                  (unsigned long long)(dropped - reported_dropped));
+            reported_dropped = dropped;
+            wrote = true;
+        }
+
+        if (wrote && file)
+        {
+            fflush(file);
+            if (file_bytes >= LOG_FILE_MAX_BYTES)
+            {
+                fclose(file);
+                file = rotate_log_file(path);
+                file_bytes = 0;
+            }
+        }
+
+        if (stopping)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    if (file)
+        fclose(file);
+}
+
+// Started lazily the first time a core asks for the log interface.
+void start_core_logger()
+{
+    std::call_once(g_log_started, []
+                   { g_log_thread = std::thread(log_thread_main); });
+}
+
+// Drains whatever is left in the ring. Call after the core is deinitialised.
+void stop_core_logger()
+{
+    if (!g_log_thread.joinable())
+        return;
+    g_log_stop.store(true, std::memory_order_release);
+    g_log_thread.join();
+}
+
+// --- Core Options ---
+// Core variables live in a fixed-size open-addressing table keyed by interned
+// strings, so GET_VARIABLE (which some cores call every frame) is a hash and a
+// probe with no allocation. Defaults come from the core's option definitions;
+// ~/.config/dendy/options/<core>.json and <core>/<rom>.json override them, are
+// resolved into the table once, and are re-read when their mtime changes.
+
+constexpr size_t OPTION_TABLE_SLOTS = 1024; // Power of two; the largest cores define a few hundred
+constexpr uint64_t OPTION_POLL_FRAMES = 60; // How often to check the JSON files for edits
+
+struct OptionSlot
+{
+    const char *key = nullptr; // Interned; nullptr marks an empty slot
+    uint32_t hash = 0;
+    const char *value = nullptr;
+    const char *default_value = nullptr;
+    uint32_t allowed_begin = 0; // Range in g_option_allowed; empty means anything goes
+    uint32_t allowed_count = 0;
+};
+
+OptionSlot g_option_table[OPTION_TABLE_SLOTS];
+size_t g_option_count = 0;
+std::unordered_set<std::string> g_option_strings; // Interned once each; node addresses are stable
+std::vector<const char *> g_option_allowed;
+std::vector<std::pair<std::string, std::string>> g_option_overrides; // Per-core, then per-game
+std::string g_option_core;                                           // e.g. "snes9x"
+std::string g_option_game;                                           // ROM file name without extension
+time_t g_option_mtimes[2] = {0, 0};
+bool g_options_updated = false; // Reported once through GET_VARIABLE_UPDATE
+
+static uint32_t hash_string(const char *s)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (; *s; ++s)
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    return h;
+}
+
+// Equal strings share one copy, so reloading the overrides only ever adds
+// values that were never seen before.
+static const char *intern_string(const std::string &s)
+{
+    return g_option_strings.insert(s).first->c_str();
+}
+
+static OptionSlot *option_find(const char *key)
+{
+    uint32_t hash = hash_string(key);
+    for (size_t i = hash & (OPTION_TABLE_SLOTS - 1);; i = (i + 1) & (OPTION_TABLE_SLOTS - 1))
+    {
+        OptionSlot &slot = g_option_table[i];
+        if (!slot.key)
+            return nullptr;
+        if (slot.hash == hash && std::strcmp(slot.key, key) == 0)
+            return &slot;
+    }
+}
+
+static bool option_allows(const OptionSlot &slot, const char *value)
+{
+    if (slot.allowed_count == 0)
+        return true;
+    for (uint32_t i = 0; i < slot.allowed_count; ++i)
+    {
+        if (std::strcmp(g_option_allowed[slot.allowed_begin + i], value) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Sets a value if the core accepts it. Returns true if the value changed.
+static bool option_set(OptionSlot &slot, const std::string &value, const char *source)
+{
+    if (slot.value && value == slot.value)
+        return false;
+    if (!option_allows(slot, value.c_str()))
+    {
+        std::cerr << "[options] Ignoring " << source << " value '" << value << "' for " << slot.key << std::endl;
         return false;
     }
+    slot.value = intern_string(value);
     return true;
 }
 
-void callback_video_refresh(const void *data, unsigned /*width*/, unsigned /*height*/, size_t /*pitch*/)
+// Registers (or re-registers) an option the core told us about.
+static void option_define(const char *key, const char *default_value, const std::vector<const char *> &allowed)
 {
-    // This callback is called once per frame from retro_run().
-    // If 'data' is RETRO_HW_FRAME_BUFFER_VALID, the core has rendered directly to our
-    // bound OpenGL context. We just need to swap the window buffers.
-    // If 'data' contains pixel data, we would need to upload it to a texture and
-    // render it to a quad. For this example, we assume hardware rendering.
-    if (data == RETRO_HW_FRAME_BUFFER_VALID)
+    OptionSlot *slot = option_find(key);
+    if (!slot)
     {
-        // Core rendered to hardware, nothing to do here.
+        if (g_option_count >= OPTION_TABLE_SLOTS / 2)
+        {
+            std::cerr << "[options] Option table full, ignoring " << key << std::endl;
+            return;
+        }
+        uint32_t hash = hash_string(key);
+        size_t i = hash & (OPTION_TABLE_SLOTS - 1);
+        while (g_option_table[i].key)
+            i = (i + 1) & (OPTION_TABLE_SLOTS - 1);
+        slot = &g_option_table[i];
+        slot->key = intern_string(key);
+        slot->hash = hash;
+        g_option_count++;
     }
-    else
+
+    slot->allowed_begin = g_option_allowed.size();
+    slot->allowed_count = 0;
+    for (const char *value : allowed)
     {
-        // Software rendering path (not implemented for this simple example)
-        // You would use glTexSubImage2D or similar here.
+        g_option_allowed.push_back(intern_string(value));
+        slot->allowed_count++;
     }
+    slot->default_value = intern_string(default_value ? default_value : (allowed.empty() ? "" : allowed[0]));
+    slot->value = slot->default_value;
 }
 
-void callback_audio_sample(int16_t left, int16_t right)
+// Minimal JSON reader for the override files: one flat object whose values are
+// strings, numbers or booleans. Returns false on anything else.
+static bool parse_flat_json(const std::string &text, std::vector<std::pair<std::string, std::string>> &out)
 {
-    int16_t buf[2] = {left, right};
-    SDL_QueueAudio(g_audio_device, buf, sizeof(buf));
+    size_t i = 0;
+    auto skip_ws = [&]
+    {
+        while (i < text.size() && std::isspace((unsigned char)text[i]))
+            i++;
+    };
+    // The four hex digits after the 'u' at text[i]; leaves i on the last one
+    auto parse_hex4 = [&](unsigned &code) -> bool
+    {
+        if (i + 4 >= text.size())
+            return false;
+        code = 0;
+        for (size_t j = i + 1; j <= i + 4; j++)
+        {
+            char c = text[j];
+            if (!std::isxdigit((unsigned char)c))
+                return false;
+            code = code * 16 + (std::isdigit((unsigned char)c) ? c - '0' : (std::tolower((unsigned char)c) - 'a' + 10));
+        }
+        i += 4;
+        return true;
+    };
+    auto parse_string = [&](std::string &result) -> bool
+    {
+        if (i >= text.size() || text[i] != '"')
+            return false;
+        for (i++; i < text.size() && text[i] != '"'; i++)
+        {
+            if (text[i] != '\\')
+            {
+                result += text[i];
+                continue;
+            }
+            if (++i >= text.size())
+                return false;
+            switch (text[i])
+            {
+            case 'n':
+                result += '\n';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'u':
+            {
+                // UTF-8, with a surrogate pair read as one code point
+                unsigned code;
+                if (!parse_hex4(code))
+                    return false;
+                if (code >= 0xDC00 && code <= 0xDFFF)
+                    return false;
+                if (code >= 0xD800 && code <= 0xDBFF)
+                {
+                    unsigned low;
+                    if (i + 2 >= text.size() || text[i + 1] != '\\' || text[i + 2] != 'u')
+                        return false;
+                    i += 2;
+                    if (!parse_hex4(low) || low < 0xDC00 || low > 0xDFFF)
+                        return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (code < 0x80)
+                {
+                    result += (char)code;
+                }
+                else if (code < 0x800)
+                {
+                    result += (char)(0xC0 | (code >> 6));
+                    result += (char)(0x80 | (code & 0x3F));
+                }
+                else if (code < 0x10000)
+                {
+                    result += (char)(0xE0 | (code >> 12));
+                    result += (char)(0x80 | ((code >> 6) & 0x3F));
+                    result += (char)(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    result += (char)(0xF0 | (code >> 18));
+                    result += (char)(0x80 | ((code >> 12) & 0x3F));
+                    result += (char)(0x80 | ((code >> 6) & 0x3F));
+                    result += (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default:
+                result += text[i]; // \" \\ \/
+                break;
+            }
+        }
+        if (i >= text.size())
+            return false;
+        i++;
+        return true;
+    };
+
+    skip_ws();
+    if (i >= text.size() || text[i++] != '{')
+        return false;
+    skip_ws();
+    if (i < text.size() && text[i] == '}')
+        return true;
+
+    for (;;)
+    {
+        std::string key, value;
+        skip_ws();
+        if (!parse_string(key))
+            return false;
+        skip_ws();
+        if (i >= text.size() || text[i++] != ':')
+            return false;
+        skip_ws();
+        if (i < text.size() && text[i] == '"')
+        {
+            if (!parse_string(value))
+                return false;
+        }
+        else
+        {
+            while (i < text.size() && (std::isalnum((unsigned char)text[i]) || text[i] == '.' || text[i] == '-'))
+                value += text[i++];
+            if (value.empty())
+                return false;
+        }
+        out.emplace_back(key, value);
+
+        skip_ws();
+        if (i < text.size() && text[i] == ',')
+        {
+            i++;
+            continue;
+        }
+        return i < text.size() && text[i] == '}';
+    }
 }
 
-size_t callback_audio_sample_batch(const int16_t *data, size_t frames)
+static std::string option_file(int index)
 {
-    SDL_QueueAudio(g_audio_device, data, frames * 2 * sizeof(int16_t));
-    return frames; // Return the number of frames consumed
+    const char *home = getenv("HOME");
+    std::filesystem::path dir = std::filesystem::path(home ? home : "/tmp") / ".config/dendy/options";
+    return index == 0 ? (dir / (g_option_core + ".json")).string()
+                      : (dir / g_option_core / (g_option_game + ".json")).string();
 }
 
-void callback_input_poll(void)
+// Re-reads the override files and applies them over the core defaults.
+// Returns true if any current value changed.
+static bool load_option_overrides()
 {
-    // Clear previous state
-    for (int i = 0; i < 16; ++i)
+    g_option_overrides.clear();
+    for (int index = 0; index < 2; ++index)
     {
-        g_keyboard_state[i] = 0;
-        g_joy_state[i] = 0;
+        std::string path = option_file(index);
+        struct stat st;
+        g_option_mtimes[index] = stat(path.c_str(), &st) == 0 ? st.st_mtime : 0;
+        if (!g_option_mtimes[index])
+            continue;
+
+        std::ifstream file(path);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        if (!parse_flat_json(contents.str(), g_option_overrides))
+        {
+            std::cerr << "[options] Could not parse " << path << std::endl;
+        }
     }
 
-    SDL_Event event;
-    while (SDL_PollEvent(&event))
+    bool changed = false;
+    for (size_t i = 0; i < OPTION_TABLE_SLOTS; ++i)
     {
-        if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE))
+        OptionSlot &slot = g_option_table[i];
+        if (!slot.key)
+            continue;
+
+        // Later entries (per-game) win over earlier ones (per-core)
+        std::string value = slot.default_value;
+        const char *source = "default";
+        for (const auto &entry : g_option_overrides)
         {
-            g_running = false;
+            if (entry.first != slot.key)
+                continue;
+            if (!option_allows(slot, entry.second.c_str()))
+            {
+                std::cerr << "[options] Ignoring override value '" << entry.second << "' for " << slot.key << std::endl;
+                continue;
+            }
+            value = entry.second;
+            source = "override";
         }
+        changed |= option_set(slot, value, source);
     }
+    return changed;
+}
 
-    // --- Keyboard Input ---
-    const Uint8 *keys = SDL_GetKeyboardState(NULL);
-    if (keys[SDL_SCANCODE_UP])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_UP] = 1;
-    if (keys[SDL_SCANCODE_DOWN])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_DOWN] = 1;
-    if (keys[SDL_SCANCODE_LEFT])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_LEFT] = 1;
-    if (keys[SDL_SCANCODE_RIGHT])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_RIGHT] = 1;
-    if (keys[SDL_SCANCODE_Z])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_A] = 1; // "A" button
-    if (keys[SDL_SCANCODE_X])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_B] = 1; // "B" button
-    if (keys[SDL_SCANCODE_A])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_X] = 1; // "X" button
-    if (keys[SDL_SCANCODE_S])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_Y] = 1; // "Y" button
-    if (keys[SDL_SCANCODE_RETURN])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_START] = 1;
-    if (keys[SDL_SCANCODE_RSHIFT])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_SELECT] = 1;
-    if (keys[SDL_SCANCODE_Q])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_L] = 1;
-    if (keys[SDL_SCANCODE_W])
-        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_R] = 1;
+static void finish_option_definitions()
+{
+    load_option_overrides();
+    size_t overridden = 0;
+    for (size_t i = 0; i < OPTION_TABLE_SLOTS; ++i)
+    {
+        if (g_option_table[i].key && std::strcmp(g_option_table[i].value, g_option_table[i].default_value) != 0)
+            overridden++;
+    }
+    std::cout << "[options] " << g_option_count << " core options, " << overridden << " overridden" << std::endl;
+}
 
-    // --- Joystick Input ---
-    if (g_joystick)
+// Picks up edits to the override files while the game runs. Call once per frame.
+void poll_option_files()
+{
+    if (g_option_count == 0 || g_frame_count % OPTION_POLL_FRAMES != 0)
+        return;
+
+    for (int index = 0; index < 2; ++index)
     {
-        SDL_JoystickUpdate();
-        // This mapping is a guess for a typical Gamecube-style controller.
-        // It may need adjustment for your specific controller.
-        if (SDL_JoystickGetButton(g_joystick, 0))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_A] = 1; // A button
-        if (SDL_JoystickGetButton(g_joystick, 1))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_B] = 1; // B button
-        if (SDL_JoystickGetButton(g_joystick, 2))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_X] = 1; // X button
-        if (SDL_JoystickGetButton(g_joystick, 3))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_Y] = 1; // Y button
-        if (SDL_JoystickGetButton(g_joystick, 4))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_L] = 1; // L shoulder
-        if (SDL_JoystickGetButton(g_joystick, 5))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_R] = 1; // R shoulder
-        if (SDL_JoystickGetButton(g_joystick, 9))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_START] = 1; // Start button
-        // Select button is often missing on GC controllers, map to Z trigger?
-        if (SDL_JoystickGetButton(g_joystick, 6))
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_SELECT] = 1; // Z trigger
+        struct stat st;
+        time_t mtime = stat(option_file(index).c_str(), &st) == 0 ? st.st_mtime : 0;
+        if (mtime != g_option_mtimes[index])
+        {
+            if (load_option_overrides())
+            {
+                std::cout << "[options] Reloaded overrides" << std::endl;
+                g_options_updated = true;
+            }
+            return;
+        }
+    }
+}
+
+// RETRO_ENVIRONMENT_SET_VARIABLES: "Description; first|second|third", first is the default
+static void define_legacy_options(const struct retro_variable *vars)
+{
+    for (; vars && vars->key; ++vars)
+    {
+        std::string spec = vars->value ? vars->value : "";
+        size_t sep = spec.find("; ");
+        std::vector<std::string> values;
+        std::stringstream list(sep == std::string::npos ? "" : spec.substr(sep + 2));
+        for (std::string value; std::getline(list, value, '|');)
+            values.push_back(value);
+
+        std::vector<const char *> allowed;
+        for (const auto &value : values)
+            allowed.push_back(value.c_str());
+        option_define(vars->key, nullptr, allowed);
+    }
+    finish_option_definitions();
+}
+
+template <typename Definition>
+static void define_options(const Definition *defs)
+{
+    for (; defs && defs->key; ++defs)
+    {
+        std::vector<const char *> allowed;
+        for (size_t i = 0; i < RETRO_NUM_CORE_OPTION_VALUES_MAX && defs->values[i].value; ++i)
+            allowed.push_back(defs->values[i].value);
+        option_define(defs->key, defs->default_value, allowed);
+    }
+    finish_option_definitions();
+}
+
+// --- Memory Accounting ---
+// Bytes the frontend itself owns, by category, beside what the kernel says the whole
+// process uses (/proc/self/smaps_rollup, which includes the core and its libraries).
+// Reported at exit and on SIGUSR1 or F9. With --memory-budget, optional buffers (the
+// recording history and the capture slots) are sized to what fits, and the history
+// is halved whenever the session later grows past the budget. Under --sandbox the
+// session is the frontend plus the core host, and only the frontend, which owns
+// those buffers, enforces it. Required buffers are only counted.
+
+constexpr unsigned MEMORY_CHECK_FRAMES = 300; // Budget check interval
+
+enum MemoryCategory
+{
+    MEM_ROM,
+    MEM_TEXTURE,
+    MEM_AUDIO,
+    MEM_SERIALIZE, // Fast resume and netplay states
+    MEM_CAPTURE,
+    MEM_VFS,
+    MEM_SANDBOX, // Shared frame, audio and input block
+    MEM_CATEGORIES,
+};
+
+const char *const MEMORY_CATEGORY_NAMES[MEM_CATEGORIES] = {"rom", "texture", "audio", "serialize",
+                                                           "capture", "vfs", "sandbox"};
+
+struct ProcessMemory
+{
+    size_t rss = 0;
+    size_t pss = 0;
+    size_t anonymous = 0;
+    size_t swap = 0;
+};
+
+std::atomic<int64_t> g_memory_owned[MEM_CATEGORIES];
+size_t g_memory_budget = 0;                         // --memory-budget, in bytes; 0 for none
+pid_t g_memory_peer = -1;                           // --sandbox: the core host, in the frontend
+volatile sig_atomic_t g_memory_report_requests = 0; // Bumped by SIGUSR1 and F9
+sig_atomic_t g_memory_reports = 0;
+
+void memory_track(MemoryCategory category, int64_t delta)
+{
+    g_memory_owned[category].fetch_add(delta, std::memory_order_relaxed);
+}
+
+// Resizes a buffer and accounts for any change in its capacity.
+template <typename T>
+void memory_resize(MemoryCategory category, std::vector<T> &buffer, size_t size)
+{
+    size_t before = buffer.capacity();
+    buffer.resize(size);
+    memory_track(category, int64_t(buffer.capacity() - before) * int64_t(sizeof(T)));
+}
+
+// This process, or another one of the session by PID.
+ProcessMemory read_process_memory(pid_t pid = 0)
+{
+    ProcessMemory mem;
+    std::ifstream rollup(pid > 0 ? "/proc/" + std::to_string(pid) + "/smaps_rollup" : "/proc/self/smaps_rollup");
+    std::string key;
+    size_t kb;
+    std::string unit;
+    while (rollup >> key)
+    {
+        if (!(rollup >> kb >> unit))
+        {
+            // The header line: address range, permissions, "[rollup]"
+            rollup.clear();
+            rollup.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            continue;
+        }
+        if (key == "Rss:")
+            mem.rss = kb * 1024;
+        else if (key == "Pss:")
+            mem.pss = kb * 1024;
+        else if (key == "Anonymous:")
+            mem.anonymous = kb * 1024;
+        else if (key == "Swap:")
+            mem.swap = kb * 1024;
+    }
+    return mem;
+}
+
+// What the budget is measured against: our RSS plus the core host's, if any.
+size_t session_rss()
+{
+    size_t rss = read_process_memory().rss;
+    if (g_memory_peer > 0)
+        rss += read_process_memory(g_memory_peer).rss;
+    return rss;
+}
+
+// Bytes of an optional buffer the budget allows, up to 'wanted'; 0 if not even 'minimum' fits.
+size_t memory_grant(size_t wanted, size_t minimum)
+{
+    if (g_memory_budget == 0)
+        return wanted;
+    size_t rss = session_rss();
+    size_t granted = std::min(wanted, g_memory_budget > rss ? g_memory_budget - rss : 0);
+    return granted >= minimum ? granted : 0;
+}
+
+void report_memory(const char *when)
+{
+    ProcessMemory mem = read_process_memory();
+    int64_t owned[MEM_CATEGORIES];
+    int64_t total = 0;
+    for (int i = 0; i < MEM_CATEGORIES; ++i)
+    {
+        owned[i] = g_memory_owned[i].load(std::memory_order_relaxed);
+        total += owned[i];
+    }
+    if (g_audio_device > 0 && !g_audio_callback.callback)
+    {
+        owned[MEM_AUDIO] += SDL_GetQueuedAudioSize(g_audio_device);
+        total += SDL_GetQueuedAudioSize(g_audio_device);
+    }
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << "[memory] " << when << ": RSS " << mem.rss / 1048576.0 << " MB (PSS "
+         << mem.pss / 1048576.0 << ", anonymous " << mem.anonymous / 1048576.0 << ", swap " << mem.swap / 1048576.0
+         << "); frontend buffers " << total / 1048576.0 << " MB:";
+    for (int i = 0; i < MEM_CATEGORIES; ++i)
+        line << " " << MEMORY_CATEGORY_NAMES[i] << " " << owned[i] / 1048576.0;
+    if (g_memory_budget)
+        line << "; budget " << g_memory_budget / 1048576.0 << " MB";
+    std::cout << line.str() << std::endl;
+}
+
+void handle_memory_report_signal(int /*sig*/)
+{
+    g_memory_report_requests++;
+}
+
+// --- Virtual File System ---
+// Cores that stream content (disc images, MAME sets) do lots of small reads through
+// the VFS interface. Read-only files are mmap'd so those reads are memcpys out of
+// the page cache; writable files get a read-ahead window and batched writes so save
+// data goes to storage in a few large writes. Per-file statistics are printed at exit.
+
+constexpr size_t VFS_READAHEAD_BYTES = 256 * 1024;
+constexpr size_t VFS_WRITE_BATCH_BYTES = 64 * 1024;
+constexpr unsigned VFS_INTERFACE_VERSION = 3;
+
+struct VfsStats
+{
+    std::atomic<uint64_t> opens{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> read_bytes{0};
+    std::atomic<uint64_t> read_ns{0}; // Includes page faults on mapped files
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> write_bytes{0};
+    std::atomic<uint64_t> syscalls{0}; // pread/pwrite issued on the core's behalf
+    bool mapped = false;
+};
+
+struct retro_vfs_file_handle
+{
+    std::string path;
+    int fd = -1;
+    int64_t size = 0;
+    int64_t pos = 0;
+    VfsStats *stats = nullptr;
+
+    // Read-only content
+    const uint8_t *map = nullptr;
+
+    // Writable files: read-ahead window and pending contiguous writes
+    std::vector<uint8_t> window;
+    int64_t window_start = 0;
+    std::vector<uint8_t> pending;
+    int64_t pending_start = 0;
+};
+
+struct retro_vfs_dir_handle
+{
+    DIR *dir = nullptr;
+    std::string path;
+    struct dirent *entry = nullptr;
+    bool include_hidden = false;
+};
+
+std::mutex g_vfs_stats_mutex;
+std::unordered_map<std::string, VfsStats> g_vfs_stats; // Node-based, so entries never move
+
+static VfsStats *vfs_stats_for(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(g_vfs_stats_mutex);
+    return &g_vfs_stats[path];
+}
+
+static bool vfs_flush_pending(struct retro_vfs_file_handle *stream)
+{
+    size_t done = 0;
+    while (done < stream->pending.size())
+    {
+        ssize_t n = pwrite(stream->fd, stream->pending.data() + done, stream->pending.size() - done,
+                           stream->pending_start + done);
+        stream->stats->syscalls++;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    stream->pending.clear();
+    return true;
+}
+
+const char *vfs_get_path(struct retro_vfs_file_handle *stream)
+{
+    return stream->path.c_str();
+}
+
+struct retro_vfs_file_handle *vfs_open(const char *path, unsigned mode, unsigned hints)
+{
+    int flags = O_CLOEXEC;
+    if ((mode & RETRO_VFS_FILE_ACCESS_READ_WRITE) == RETRO_VFS_FILE_ACCESS_READ_WRITE)
+        flags |= O_RDWR | O_CREAT;
+    else if (mode & RETRO_VFS_FILE_ACCESS_WRITE)
+        flags |= O_WRONLY | O_CREAT;
+    else
+        flags |= O_RDONLY;
+    if ((mode & RETRO_VFS_FILE_ACCESS_WRITE) && !(mode & RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING))
+        flags |= O_TRUNC;
+
+    int fd = open(path, flags, 0644);
+    if (fd < 0)
+        return nullptr;
+
+    auto *stream = new retro_vfs_file_handle();
+    stream->path = path;
+    stream->fd = fd;
+    stream->stats = vfs_stats_for(stream->path);
+    stream->stats->opens++;
+
+    struct stat st = {}; // Left zeroed (not a regular file) if fstat fails
+    if (fstat(fd, &st) == 0)
+        stream->size = st.st_size;
+
+    if (!(mode & RETRO_VFS_FILE_ACCESS_WRITE) && S_ISREG(st.st_mode) && stream->size > 0)
+    {
+        void *map = mmap(nullptr, stream->size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            // Small, frequently hit files get paged in now; streamed ones get aggressive readahead
+            madvise(map, stream->size, (hints & RETRO_VFS_FILE_ACCESS_HINT_FREQUENT_ACCESS) ? MADV_WILLNEED : MADV_SEQUENTIAL);
+            stream->map = static_cast<const uint8_t *>(map);
+            stream->stats->mapped = true;
+        }
+    }
+    if (!stream->map)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return stream;
+}
+
+int vfs_close(struct retro_vfs_file_handle *stream)
+{
+    bool ok = vfs_flush_pending(stream);
+    memory_track(MEM_VFS, -int64_t(stream->window.capacity() + stream->pending.capacity()));
+    if (stream->map)
+        munmap(const_cast<uint8_t *>(stream->map), stream->size);
+    ok &= close(stream->fd) == 0;
+    delete stream;
+    return ok ? 0 : -1;
+}
+
+int64_t vfs_size(struct retro_vfs_file_handle *stream)
+{
+    return stream->size;
+}
+
+int64_t vfs_tell(struct retro_vfs_file_handle *stream)
+{
+    return stream->pos;
+}
+
+int64_t vfs_seek(struct retro_vfs_file_handle *stream, int64_t offset, int seek_position)
+{
+    int64_t base = seek_position == RETRO_VFS_SEEK_POSITION_CURRENT ? stream->pos
+                   : seek_position == RETRO_VFS_SEEK_POSITION_END   ? stream->size
+                                                                    : 0;
+    if (base + offset < 0)
+        return -1;
+    stream->pos = base + offset;
+    return stream->pos;
+}
+
+int64_t vfs_read(struct retro_vfs_file_handle *stream, void *s, uint64_t len)
+{
+    uint64_t start = now_ns();
+    uint8_t *out = static_cast<uint8_t *>(s);
+    int64_t available = std::max<int64_t>(0, stream->size - stream->pos);
+    uint64_t total = std::min<uint64_t>(len, available);
+
+    if (stream->map)
+    {
+        std::memcpy(out, stream->map + stream->pos, total);
+    }
+    else
+    {
+        // Reads must observe our own batched writes
+        if (!stream->pending.empty() && !vfs_flush_pending(stream))
+            return -1;
+
+        uint64_t done = 0;
+        while (done < total)
+        {
+            int64_t at = stream->pos + done;
+            int64_t window_end = stream->window_start + (int64_t)stream->window.size();
+            if (at < stream->window_start || at >= window_end)
+            {
+                // Refill the window at the current position
+                memory_resize(MEM_VFS, stream->window, VFS_READAHEAD_BYTES);
+                ssize_t n = pread(stream->fd, stream->window.data(), VFS_READAHEAD_BYTES, at);
+                stream->stats->syscalls++;
+                if (n <= 0)
+                {
+                    stream->window.clear();
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    break;
+                }
+                stream->window.resize(n);
+                stream->window_start = at;
+                window_end = at + n;
+            }
+            uint64_t chunk = std::min<uint64_t>(total - done, window_end - at);
+            std::memcpy(out + done, stream->window.data() + (at - stream->window_start), chunk);
+            done += chunk;
+        }
+        total = done;
+    }
+
+    stream->pos += total;
+    stream->stats->reads++;
+    stream->stats->read_bytes += total;
+    stream->stats->read_ns += now_ns() - start;
+    return total;
+}
+
+int64_t vfs_write(struct retro_vfs_file_handle *stream, const void *s, uint64_t len)
+{
+    if (stream->map)
+        return -1; // Opened read-only
+
+    // Only contiguous writes are batched; anything else flushes the batch first
+    int64_t pending_end = stream->pending_start + (int64_t)stream->pending.size();
+    if (!stream->pending.empty() && stream->pos != pending_end && !vfs_flush_pending(stream))
+        return -1;
+    if (stream->pending.empty())
+        stream->pending_start = stream->pos;
+
+    const uint8_t *in = static_cast<const uint8_t *>(s);
+    size_t capacity = stream->pending.capacity();
+    stream->pending.insert(stream->pending.end(), in, in + len);
+    memory_track(MEM_VFS, int64_t(stream->pending.capacity() - capacity));
+    if (stream->pending.size() >= VFS_WRITE_BATCH_BYTES && !vfs_flush_pending(stream))
+        return -1;
+
+    // Keep the read-ahead window coherent with what we just wrote
+    int64_t window_end = stream->window_start + (int64_t)stream->window.size();
+    if (stream->pos < window_end && stream->pos + (int64_t)len > stream->window_start)
+        stream->window.clear();
+
+    stream->pos += len;
+    stream->size = std::max(stream->size, stream->pos);
+    stream->stats->writes++;
+    stream->stats->write_bytes += len;
+    return len;
+}
+
+int vfs_flush(struct retro_vfs_file_handle *stream)
+{
+    return vfs_flush_pending(stream) ? 0 : -1;
+}
+
+int vfs_remove(const char *path)
+{
+    return unlink(path) == 0 ? 0 : -1;
+}
+
+int vfs_rename(const char *old_path, const char *new_path)
+{
+    return rename(old_path, new_path) == 0 ? 0 : -1;
+}
+
+int64_t vfs_truncate(struct retro_vfs_file_handle *stream, int64_t length)
+{
+    if (stream->map || !vfs_flush_pending(stream) || ftruncate(stream->fd, length) != 0)
+        return -1;
+    stream->window.clear();
+    stream->size = length;
+    return 0;
+}
+
+int vfs_stat(const char *path, int32_t *size)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    if (size)
+        *size = (int32_t)st.st_size;
+    return RETRO_VFS_STAT_IS_VALID | (S_ISDIR(st.st_mode) ? RETRO_VFS_STAT_IS_DIRECTORY : 0) |
+           (S_ISCHR(st.st_mode) ? RETRO_VFS_STAT_IS_CHARACTER_SPECIAL : 0);
+}
+
+int vfs_mkdir(const char *dir)
+{
+    if (mkdir(dir, 0755) == 0)
+        return 0;
+    return errno == EEXIST ? -2 : -1;
+}
+
+struct retro_vfs_dir_handle *vfs_opendir(const char *dir, bool include_hidden)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return nullptr;
+    auto *dirstream = new retro_vfs_dir_handle();
+    dirstream->dir = d;
+    dirstream->path = dir;
+    dirstream->include_hidden = include_hidden;
+    return dirstream;
+}
+
+bool vfs_readdir(struct retro_vfs_dir_handle *dirstream)
+{
+    while ((dirstream->entry = readdir(dirstream->dir)))
+    {
+        const char *name = dirstream->entry->d_name;
+        if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+            continue;
+        if (name[0] == '.' && !dirstream->include_hidden)
+            continue;
+        return true;
+    }
+    return false;
+}
+
+const char *vfs_dirent_get_name(struct retro_vfs_dir_handle *dirstream)
+{
+    return dirstream->entry ? dirstream->entry->d_name : nullptr;
+}
+
+bool vfs_dirent_is_dir(struct retro_vfs_dir_handle *dirstream)
+{
+    if (!dirstream->entry)
+        return false;
+    if (dirstream->entry->d_type != DT_UNKNOWN && dirstream->entry->d_type != DT_LNK)
+        return dirstream->entry->d_type == DT_DIR;
+    struct stat st;
+    std::string full = dirstream->path + "/" + dirstream->entry->d_name;
+    return stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+int vfs_closedir(struct retro_vfs_dir_handle *dirstream)
+{
+    int ret = closedir(dirstream->dir);
+    delete dirstream;
+    return ret == 0 ? 0 : -1;
+}
+
+struct retro_vfs_interface g_vfs_interface = {
+    vfs_get_path, vfs_open, vfs_close, vfs_size, vfs_tell, vfs_seek, vfs_read, vfs_write, vfs_flush,
+    vfs_remove, vfs_rename, vfs_truncate, vfs_stat, vfs_mkdir, vfs_opendir, vfs_readdir,
+    vfs_dirent_get_name, vfs_dirent_is_dir, vfs_closedir};
+
+// Prints what each file cost the core, busiest first.
+void report_vfs_stats()
+{
+    std::lock_guard<std::mutex> lock(g_vfs_stats_mutex);
+    std::vector<std::pair<const std::string *, const VfsStats *>> files;
+    for (const auto &entry : g_vfs_stats)
+        files.push_back({&entry.first, &entry.second});
+    std::sort(files.begin(), files.end(), [](const auto &a, const auto &b)
+              { return a.second->read_ns > b.second->read_ns; });
+
+    for (const auto &file : files)
+    {
+        const VfsStats &st = *file.second;
+        std::cout << "[vfs] " << *file.first << (st.mapped ? " (mmap)" : "") << ": " << st.opens << " opens, "
+                  << st.reads << " reads / " << st.read_bytes / 1024 << " KB in " << st.read_ns / 1e6 << " ms, "
+                  << st.writes << " writes / " << st.write_bytes / 1024 << " KB, " << st.syscalls << " syscalls"
+                  << std::endl;
+    }
+}
+
+// --- Disk Control ---
+// Multi-disc content (PlayStation .cue/.pbp sets, usually listed in an .m3u) is swapped
+// through the core's disk control interface with F2 or Select+R. While a disc plays, a
+// thread at idle I/O priority pulls the next one into the page cache so that a swap
+// doesn't stall on cold storage.
+
+constexpr unsigned DISC_TRAY_OPEN_FRAMES = 30; // Some games only notice a swap if the tray stays open for a moment
+constexpr size_t PREFETCH_CHUNK_BYTES = 4 * 1024 * 1024;
+constexpr int IOPRIO_WHO_THREAD = 1;
+constexpr int IOPRIO_IDLE = 3 << 13; // IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+
+struct retro_disk_control_ext_callback g_disk_control = {};
+bool g_has_disk_control = false;
+std::vector<std::string> g_playlist; // Disc paths from an .m3u the core can't open itself
+uint32_t g_disc_swap_requests = 0;   // Bumped by the swap hotkey
+uint32_t g_disc_swaps_handled = 0;
+uint64_t g_disc_tray_close_frame = 0; // Nonzero while the tray is open after a swap
+std::thread g_prefetch_thread;                      // Started by the first prefetch request
+std::mutex g_prefetch_mutex;
+std::condition_variable g_prefetch_wake;
+std::string g_prefetch_request;                     // Disc image for the prefetch thread to warm next
+std::atomic<uint32_t> g_prefetch_generation{0};     // Bumped per request; a stale pass gives up
+std::atomic<bool> g_prefetch_stop{false};
+
+// Lists the discs in an .m3u, resolved relative to the playlist.
+std::vector<std::string> parse_m3u(const std::string &path)
+{
+    std::vector<std::string> discs;
+    std::ifstream file(path);
+    std::string line;
+    std::filesystem::path base = std::filesystem::path(path).parent_path();
+    while (std::getline(file, line))
+    {
+        line.erase(line.find_last_not_of(" \t\r\n") + 1);
+        if (line.empty() || line[0] == '#')
+            continue;
+        line = line.substr(0, line.find('|')); // Strip "|label" suffixes
+        std::filesystem::path disc(line);
+        discs.push_back((disc.is_absolute() ? disc : base / disc).string());
+    }
+    return discs;
+}
+
+// The files that make up one disc image: a .cue's tracks, or the image itself.
+std::vector<std::string> disc_files(const std::string &image)
+{
+    std::vector<std::string> files;
+    std::string ext = std::filesystem::path(image).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext != ".cue")
+    {
+        files.push_back(image);
+        return files;
+    }
+
+    std::ifstream cue(image);
+    std::string line;
+    std::filesystem::path base = std::filesystem::path(image).parent_path();
+    while (std::getline(cue, line))
+    {
+        size_t at = line.find("FILE");
+        if (at == std::string::npos)
+            continue;
+        size_t open_quote = line.find('"', at);
+        size_t close_quote = line.find('"', open_quote + 1);
+        if (open_quote == std::string::npos || close_quote == std::string::npos)
+            continue;
+        files.push_back((base / line.substr(open_quote + 1, close_quote - open_quote - 1)).string());
+    }
+    return files;
+}
+
+static uint64_t mem_available_bytes()
+{
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    uint64_t kb = 0;
+    while (meminfo >> key >> kb)
+    {
+        if (key == "MemAvailable:")
+            return kb * 1024;
+        meminfo.ignore(INT_MAX, '\n');
+    }
+    return 0;
+}
+
+// Prefetch thread. Resolves a disc image to its files and queues readahead for
+// them, unless a newer request or shutdown comes in first.
+static void prefetch_disc(const std::string &image, uint32_t generation)
+{
+    auto cancelled = [generation]
+    { return g_prefetch_stop || g_prefetch_generation != generation; };
+
+    std::vector<std::string> files = disc_files(image);
+    uint64_t bytes = 0;
+    for (const auto &file : files)
+    {
+        std::error_code ec;
+        bytes += std::filesystem::file_size(file, ec);
+    }
+    // Don't evict the disc that is playing to make room for the next one
+    if (bytes > mem_available_bytes() / 2)
+    {
+        std::cout << "[disc] Not prefetching " << image << ": " << bytes / (1024 * 1024)
+                  << " MB exceeds half of available memory" << std::endl;
+        return;
+    }
+
+    uint64_t start = now_ns();
+    uint64_t total = 0;
+    for (const auto &path : files)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            for (off_t offset = 0; offset < st.st_size && !cancelled(); offset += PREFETCH_CHUNK_BYTES)
+            {
+                readahead(fd, offset, PREFETCH_CHUNK_BYTES);
+                total += std::min<uint64_t>(PREFETCH_CHUNK_BYTES, st.st_size - offset);
+            }
+        }
+        close(fd);
+    }
+    if (!cancelled())
+    {
+        std::cout << "[disc] Queued readahead of " << total / (1024 * 1024) << " MB in " << (now_ns() - start) / 1e6
+                  << " ms" << std::endl;
+    }
+}
+
+void prefetch_thread_main()
+{
+    unpin_helper_thread();
+
+    // Idle class: the running disc's reads always win
+    syscall(SYS_ioprio_set, IOPRIO_WHO_THREAD, 0, IOPRIO_IDLE);
+
+    for (;;)
+    {
+        std::string image;
+        uint32_t generation;
+        {
+            std::unique_lock<std::mutex> lock(g_prefetch_mutex);
+            g_prefetch_wake.wait(lock, []
+                                 { return g_prefetch_stop || !g_prefetch_request.empty(); });
+            if (g_prefetch_stop)
+                return;
+            image.swap(g_prefetch_request);
+            generation = g_prefetch_generation;
+        }
+        prefetch_disc(image, generation);
+    }
+}
+
+void stop_disc_prefetch()
+{
+    if (g_prefetch_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_prefetch_mutex);
+            g_prefetch_stop = true;
+        }
+        g_prefetch_wake.notify_one();
+        g_prefetch_thread.join();
+    }
+    g_prefetch_stop = false;
+    g_prefetch_request.clear();
+}
+
+std::string disc_image_path(unsigned index)
+{
+    char path[PATH_MAX];
+    if (g_disk_control.get_image_path && g_disk_control.get_image_path(index, path, sizeof(path)))
+        return path;
+    return index < g_playlist.size() ? g_playlist[index] : std::string();
+}
+
+// Warms the page cache for the disc after the current one. Only asks the core
+// for the path; the file I/O all happens on the prefetch thread.
+void prefetch_next_disc()
+{
+    if (!g_has_disk_control || g_disk_control.get_num_images() < 2)
+        return;
+    unsigned next = (g_disk_control.get_image_index() + 1) % g_disk_control.get_num_images();
+    std::string image = disc_image_path(next);
+    if (image.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(g_prefetch_mutex);
+        g_prefetch_request = std::move(image);
+        g_prefetch_generation++;
+    }
+    g_prefetch_wake.notify_one();
+    if (!g_prefetch_thread.joinable())
+        g_prefetch_thread = std::thread(prefetch_thread_main);
+}
+
+// For an .m3u, returns the path to hand the core: the playlist itself if the core
+// reads them, otherwise its first disc (the rest are inserted after loading).
+std::string resolve_content_path(const std::string &rom_path)
+{
+    std::string ext = std::filesystem::path(rom_path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext != ".m3u")
+        return rom_path;
+
+    struct retro_system_info info = {};
+    core_retro_get_system_info(&info);
+    std::string valid = info.valid_extensions ? info.valid_extensions : "";
+    if (("|" + valid + "|").find("|m3u|") != std::string::npos)
+        return rom_path;
+
+    g_playlist = parse_m3u(rom_path);
+    if (g_playlist.empty())
+        throw std::runtime_error("Playlist has no discs: " + rom_path);
+    return g_playlist[0];
+}
+
+// Called after retro_load_game.
+void start_disk_control()
+{
+    if (!g_has_disk_control)
+        return;
+
+    if (g_playlist.size() > 1)
+    {
+        for (size_t i = 1; i < g_playlist.size(); ++i)
+        {
+            struct retro_game_info disc = {};
+            disc.path = g_playlist[i].c_str();
+            g_disk_control.add_image_index();
+            g_disk_control.replace_image_index(g_disk_control.get_num_images() - 1, &disc);
+        }
+    }
+
+    unsigned count = g_disk_control.get_num_images();
+    if (count > 1)
+    {
+        std::cout << "[disc] " << count << " discs, playing disc " << g_disk_control.get_image_index() + 1
+                  << std::endl;
+        prefetch_next_disc();
+    }
+}
+
+// Runs once per frame on the thread that runs the core.
+void service_disk_control()
+{
+    if (!g_has_disk_control)
+        return;
+
+    if (g_disc_tray_close_frame && g_frame_count >= g_disc_tray_close_frame)
+    {
+        g_disc_tray_close_frame = 0;
+        g_disk_control.set_eject_state(false);
+
+        unsigned index = g_disk_control.get_image_index();
+        char label[256];
+        if (!g_disk_control.get_image_label || !g_disk_control.get_image_label(index, label, sizeof(label)))
+            snprintf(label, sizeof(label), "disc %u", index + 1);
+        std::cout << "[disc] Inserted " << label << std::endl;
+        prefetch_next_disc();
+    }
+
+    if (g_disc_swap_requests == g_disc_swaps_handled)
+        return;
+    g_disc_swaps_handled = g_disc_swap_requests;
+
+    unsigned count = g_disk_control.get_num_images();
+    if (count < 2 || g_disc_tray_close_frame)
+        return;
+    unsigned next = (g_disk_control.get_image_index() + 1) % count;
+    if (g_disk_control.set_eject_state(true) && g_disk_control.set_image_index(next))
+    {
+        g_disc_tray_close_frame = g_frame_count + DISC_TRAY_OPEN_FRAMES;
+    }
+    else
+    {
+        g_disk_control.set_eject_state(false);
+        std::cerr << "[disc] The core refused to swap to disc " << next + 1 << std::endl;
+    }
+}
+
+// --- Capture ---
+// F12 saves a PNG screenshot. With --record, the last RECORD_SECONDS of video and audio
+// are kept and F10 dumps them as Y4M + WAV. The emulation thread only copies each frame
+// (plus the audio produced since the previous one) into a preallocated slot ring; if
+// the encoder thread falls behind, frames are dropped and counted instead of blocking
+// the core. The encoder runs at idle priority and keeps the history deflated.
+
+constexpr size_t CAPTURE_SLOTS = 16; // Power of two
+constexpr size_t CAPTURE_AUDIO_FRAMES = 8192; // Per video frame; anything beyond is cut
+constexpr unsigned RECORD_SECONDS = 30;
+constexpr size_t RECORD_MEMORY_MAX = 96 * 1024 * 1024; // Cap on the compressed history
+constexpr size_t RECORD_MEMORY_MIN = 8 * 1024 * 1024;  // Below this --record is refused under a budget
+
+struct CaptureSlot
+{
+    std::vector<uint8_t> pixels; // Packed rows in the core's pixel format
+    std::vector<int16_t> audio;  // Interleaved stereo
+    size_t audio_frames = 0;
+    unsigned width = 0; // 0 means the core duped the previous frame
+    unsigned height = 0;
+    enum retro_pixel_format format = RETRO_PIXEL_FORMAT_0RGB1555;
+    uint64_t frame = 0;
+    bool screenshot = false;
+    bool record = false;
+};
+
+struct RecordedFrame
+{
+    std::vector<uint8_t> packed; // Deflated pixels
+    std::vector<int16_t> audio;
+    unsigned width = 0;
+    unsigned height = 0;
+    enum retro_pixel_format format = RETRO_PIXEL_FORMAT_0RGB1555;
+};
+
+CaptureSlot g_capture_slots[CAPTURE_SLOTS];
+alignas(64) std::atomic<uint64_t> g_capture_write{0}; // Published by the emulation thread
+alignas(64) std::atomic<uint64_t> g_capture_read{0};  // Advanced by the encoder thread
+std::atomic<uint64_t> g_capture_dropped{0};
+std::atomic<uint32_t> g_record_dump_requests{0};
+bool g_capture_started = false;
+bool g_record = false;                // Keep the last RECORD_SECONDS (--record)
+std::vector<int16_t> g_capture_audio; // Audio since the last published frame
+size_t g_capture_audio_frames = 0;
+uint64_t g_capture_frames = 0;
+uint32_t g_screenshot_requests = 0;
+uint32_t g_screenshots_taken = 0;
+double g_capture_fps = 60.0;
+double g_capture_sample_rate = 48000.0;
+std::string g_capture_name; // ROM stem, used in file names
+std::thread g_capture_thread;
+std::thread g_dump_thread;
+std::atomic<bool> g_capture_stop{false};
+std::atomic<size_t> g_record_memory_limit{RECORD_MEMORY_MAX}; // Lowered by the memory budget
+
+static inline unsigned pixel_size(enum retro_pixel_format format)
+{
+    return format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+}
+
+// Converts one pixel of a core framebuffer to 8-bit RGB.
+static inline void pixel_to_rgb(const uint8_t *src, enum retro_pixel_format format, uint8_t *rgb)
+{
+    switch (format)
+    {
+    case RETRO_PIXEL_FORMAT_XRGB8888:
+    {
+        uint32_t p;
+        std::memcpy(&p, src, 4);
+        rgb[0] = p >> 16;
+        rgb[1] = p >> 8;
+        rgb[2] = p;
+        break;
+    }
+    case RETRO_PIXEL_FORMAT_RGB565:
+    {
+        uint16_t p;
+        std::memcpy(&p, src, 2);
+        rgb[0] = ((p >> 11) & 0x1f) * 255 / 31;
+        rgb[1] = ((p >> 5) & 0x3f) * 255 / 63;
+        rgb[2] = (p & 0x1f) * 255 / 31;
+        break;
+    }
+    default: // 0RGB1555
+    {
+        uint16_t p;
+        std::memcpy(&p, src, 2);
+        rgb[0] = ((p >> 10) & 0x1f) * 255 / 31;
+        rgb[1] = ((p >> 5) & 0x1f) * 255 / 31;
+        rgb[2] = (p & 0x1f) * 255 / 31;
+        break;
+    }
+    }
+}
+
+// Emulation thread. Nearest-neighbour samples a software frame into g_thumb_pixels;
+// does nothing until prepare_resume has allocated it.
+void sample_thumbnail(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+    if (g_thumb_pixels.empty() || width == 0 || height == 0)
+        return;
+
+    unsigned step = std::max((width + RESUME_THUMB_MAX - 1) / RESUME_THUMB_MAX,
+                             (height + RESUME_THUMB_MAX - 1) / RESUME_THUMB_MAX);
+    g_thumb_width = width / step;
+    g_thumb_height = height / step;
+    g_thumb_format = g_pixel_format;
+
+    const uint8_t *frame = static_cast<const uint8_t *>(data);
+    unsigned bpp = pixel_size(g_pixel_format);
+    uint8_t *out = g_thumb_pixels.data();
+    for (uint32_t y = 0; y < g_thumb_height; ++y)
+    {
+        const uint8_t *row = frame + (size_t)y * step * pitch;
+        for (uint32_t x = 0; x < g_thumb_width; ++x, out += bpp)
+        {
+            if (bpp == 4)
+                std::memcpy(out, row + (size_t)x * step * 4, 4);
+            else
+                std::memcpy(out, row + (size_t)x * step * 2, 2);
+        }
+    }
+}
+
+// Emulation thread. Buffers audio until the next frame is captured.
+void capture_audio(const int16_t *data, size_t frames)
+{
+    if (!g_capture_started)
+        return;
+    frames = std::min(frames, CAPTURE_AUDIO_FRAMES - g_capture_audio_frames);
+    std::memcpy(&g_capture_audio[g_capture_audio_frames * 2], data, frames * 2 * sizeof(int16_t));
+    g_capture_audio_frames += frames;
+}
+
+// Emulation thread. Never blocks or allocates; data is nullptr for a duped frame.
+void capture_frame(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+    bool screenshot = data && g_screenshot_requests != g_screenshots_taken;
+    if (!g_capture_started || (!g_record && !screenshot))
+        return;
+
+    uint64_t frame = g_capture_frames++;
+    uint64_t write = g_capture_write.load(std::memory_order_relaxed);
+    size_t row_bytes = (size_t)width * pixel_size(g_pixel_format);
+    CaptureSlot &slot = g_capture_slots[write & (CAPTURE_SLOTS - 1)];
+    if (write - g_capture_read.load(std::memory_order_acquire) >= CAPTURE_SLOTS ||
+        row_bytes * height > slot.pixels.size())
+    {
+        // The audio stays buffered for the next frame that makes it
+        g_capture_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint8_t *src = static_cast<const uint8_t *>(data);
+    for (unsigned y = 0; data && y < height; ++y)
+    {
+        std::memcpy(&slot.pixels[y * row_bytes], src + y * pitch, row_bytes);
+    }
+    std::memcpy(slot.audio.data(), g_capture_audio.data(), g_capture_audio_frames * 2 * sizeof(int16_t));
+    slot.audio_frames = g_capture_audio_frames;
+    slot.width = data ? width : 0;
+    slot.height = data ? height : 0;
+    slot.format = g_pixel_format;
+    slot.frame = frame;
+    slot.screenshot = screenshot;
+    slot.record = g_record;
+    g_capture_audio_frames = 0;
+    g_screenshots_taken = g_screenshot_requests;
+    g_capture_write.store(write + 1, std::memory_order_release);
+}
+
+static std::string capture_file(const std::string &suffix)
+{
+    const char *home = getenv("HOME");
+    std::filesystem::path dir = std::filesystem::path(home ? home : "/tmp") / ".local/share/dendy/captures";
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    char stamp[32];
+    time_t now = time(nullptr);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    return (dir / (g_capture_name + "-" + stamp + suffix)).string();
+}
+
+static void put_be32(std::vector<uint8_t> &out, uint32_t v)
+{
+    uint8_t b[4] = {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)};
+    out.insert(out.end(), b, b + 4);
+}
+
+static void png_chunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, uint32_t length)
+{
+    put_be32(out, length);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + length);
+    put_be32(out, crc32(0, &out[start], length + 4));
+}
+
+// Encoder thread. scratch and png are reused between screenshots.
+void write_png(const CaptureSlot &slot, std::vector<uint8_t> &scratch, std::vector<uint8_t> &png)
+{
+    unsigned bpp = pixel_size(slot.format);
+    size_t stride = 1 + (size_t)slot.width * 3; // Filter byte, then RGB
+    scratch.resize(stride * slot.height);
+    for (unsigned y = 0; y < slot.height; ++y)
+    {
+        uint8_t *out = &scratch[y * stride];
+        *out++ = 0;
+        const uint8_t *row = &slot.pixels[(size_t)y * slot.width * bpp];
+        for (unsigned x = 0; x < slot.width; ++x, out += 3)
+            pixel_to_rgb(row + x * bpp, slot.format, out);
+    }
+
+    png.assign({0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'});
+    uint8_t ihdr[13] = {0};
+    uint8_t dims[8] = {uint8_t(slot.width >> 24), uint8_t(slot.width >> 16), uint8_t(slot.width >> 8), uint8_t(slot.width),
+                       uint8_t(slot.height >> 24), uint8_t(slot.height >> 16), uint8_t(slot.height >> 8), uint8_t(slot.height)};
+    std::memcpy(ihdr, dims, 8);
+    ihdr[8] = 8; // Bit depth
+    ihdr[9] = 2; // Truecolour
+    png_chunk(png, "IHDR", ihdr, sizeof(ihdr));
+
+    std::vector<uint8_t> idat(compressBound(scratch.size()));
+    uLongf idat_size = idat.size();
+    compress2(idat.data(), &idat_size, scratch.data(), scratch.size(), Z_DEFAULT_COMPRESSION);
+    png_chunk(png, "IDAT", idat.data(), idat_size);
+    png_chunk(png, "IEND", nullptr, 0);
+
+    std::string path = capture_file("-" + std::to_string(slot.frame) + ".png");
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(png.data()), png.size());
+    std::cout << "[capture] Screenshot saved to " << path << std::endl;
+}
+
+// Dump thread. Writes the history as 4:2:0 Y4M plus a 16-bit stereo WAV.
+void dump_recording(std::deque<RecordedFrame> history, uint64_t dropped)
+{
+    unpin_helper_thread();
+
+    // Frames of a different size than the newest one (mid-history mode changes) repeat the last good frame
+    unsigned width = 0, height = 0;
+    for (auto it = history.rbegin(); it != history.rend() && width == 0; ++it)
+    {
+        width = it->width;
+        height = it->height;
+    }
+    if (width == 0)
+    {
+        std::cout << "[capture] Nothing recorded yet" << std::endl;
+        return;
+    }
+
+    std::string base = capture_file("");
+    FILE *video = fopen((base + ".y4m").c_str(), "wb");
+    FILE *audio = fopen((base + ".wav").c_str(), "wb");
+    if (!video || !audio)
+    {
+        std::cerr << "[capture] Failed to open " << base << ".y4m/.wav for writing" << std::endl;
+        if (video)
+            fclose(video);
+        if (audio)
+            fclose(audio);
+        return;
+    }
+
+    fprintf(video, "YUV4MPEG2 W%u H%u F%u:1000 Ip A1:1 C420jpeg\n", width, height, (unsigned)(g_capture_fps * 1000 + 0.5));
+    uint8_t wav_header[44] = {0};
+    fwrite(wav_header, 1, sizeof(wav_header), audio); // Filled in once the length is known
+
+    unsigned chroma_w = (width + 1) / 2, chroma_h = (height + 1) / 2;
+    std::vector<uint8_t> pixels(width * height * 4);
+    std::vector<uint8_t> rgb(width * height * 3);
+    std::vector<uint8_t> yuv(width * height + 2 * chroma_w * chroma_h, 0);
+    std::fill(yuv.begin() + width * height, yuv.end(), 128); // Black until the first frame
+    std::fill(yuv.begin(), yuv.begin() + width * height, 16);
+    uint64_t audio_frames = 0;
+
+    for (const RecordedFrame &rec : history)
+    {
+        fwrite(rec.audio.data(), sizeof(int16_t), rec.audio.size(), audio);
+        audio_frames += rec.audio.size() / 2;
+
+        uLongf size = pixels.size();
+        if (rec.width == width && rec.height == height &&
+            uncompress(pixels.data(), &size, rec.packed.data(), rec.packed.size()) == Z_OK)
+        {
+            unsigned bpp = pixel_size(rec.format);
+            for (size_t i = 0; i < (size_t)width * height; ++i)
+                pixel_to_rgb(&pixels[i * bpp], rec.format, &rgb[i * 3]);
+
+            // BT.601 limited range, chroma averaged over 2x2 blocks
+            uint8_t *y_plane = yuv.data();
+            uint8_t *u_plane = y_plane + width * height;
+            uint8_t *v_plane = u_plane + chroma_w * chroma_h;
+            for (unsigned y = 0; y < height; ++y)
+            {
+                for (unsigned x = 0; x < width; ++x)
+                {
+                    const uint8_t *p = &rgb[(y * width + x) * 3];
+                    y_plane[y * width + x] = (66 * p[0] + 129 * p[1] + 25 * p[2] + 128) / 256 + 16;
+                }
+            }
+            for (unsigned cy = 0; cy < chroma_h; ++cy)
+            {
+                for (unsigned cx = 0; cx < chroma_w; ++cx)
+                {
+                    int r = 0, g = 0, b = 0, n = 0;
+                    for (unsigned dy = 0; dy < 2 && cy * 2 + dy < height; ++dy)
+                    {
+                        for (unsigned dx = 0; dx < 2 && cx * 2 + dx < width; ++dx, ++n)
+                        {
+                            const uint8_t *p = &rgb[((cy * 2 + dy) * width + cx * 2 + dx) * 3];
+                            r += p[0];
+                            g += p[1];
+                            b += p[2];
+                        }
+                    }
+                    r /= n;
+                    g /= n;
+                    b /= n;
+                    u_plane[cy * chroma_w + cx] = (-38 * r - 74 * g + 112 * b + 128) / 256 + 128;
+                    v_plane[cy * chroma_w + cx] = (112 * r - 94 * g - 18 * b + 128) / 256 + 128;
+                }
+            }
+        }
+        fputs("FRAME\n", video);
+        fwrite(yuv.data(), 1, yuv.size(), video);
+    }
+    fclose(video);
+
+    uint32_t rate = (uint32_t)(g_capture_sample_rate + 0.5);
+    uint32_t data_bytes = audio_frames * 4;
+    auto le32 = [&](int at, uint32_t v)
+    { for (int i = 0; i < 4; ++i) wav_header[at + i] = v >> (8 * i); };
+    std::memcpy(wav_header, "RIFF", 4);
+    le32(4, 36 + data_bytes);
+    std::memcpy(wav_header + 8, "WAVEfmt ", 8);
+    le32(16, 16);
+    wav_header[20] = 1; // PCM
+    wav_header[22] = 2; // Channels
+    le32(24, rate);
+    le32(28, rate * 4);
+    wav_header[32] = 4;  // Block align
+    wav_header[34] = 16; // Bits per sample
+    std::memcpy(wav_header + 36, "data", 4);
+    le32(40, data_bytes);
+    fseek(audio, 0, SEEK_SET);
+    fwrite(wav_header, 1, sizeof(wav_header), audio);
+    fclose(audio);
+
+    std::cout << "[capture] Saved " << history.size() << " frames (" << history.size() / g_capture_fps << " s) to "
+              << base << ".y4m/.wav; " << dropped << " frames dropped so far" << std::endl;
+}
+
+void capture_thread_main()
+{
+    unpin_helper_thread();
+
+    // Idle CPU and I/O priority: encoding must never compete with the core
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_THREAD, 0, IOPRIO_IDLE);
+
+    std::deque<RecordedFrame> history;
+    size_t history_bytes = 0;
+    size_t max_frames = (size_t)(RECORD_SECONDS * g_capture_fps);
+    std::vector<uint8_t> scratch, png, packed;
+    size_t tracked_bytes = 0;
+    uint32_t dumps = 0;
+
+    for (;;)
+    {
+        bool stopping = g_capture_stop.load(std::memory_order_acquire);
+        uint64_t read = g_capture_read.load(std::memory_order_relaxed);
+        while (read != g_capture_write.load(std::memory_order_acquire))
+        {
+            const CaptureSlot &slot = g_capture_slots[read & (CAPTURE_SLOTS - 1)];
+            if (slot.screenshot)
+            {
+                write_png(slot, scratch, png);
+            }
+            if (slot.record)
+            {
+                // Recycle the oldest frame's buffers once the history is full
+                RecordedFrame rec;
+                if (history.size() >= max_frames)
+                {
+                    rec = std::move(history.front());
+                    history.pop_front();
+                    history_bytes -= rec.packed.capacity() + rec.audio.capacity() * sizeof(int16_t);
+                }
+                // Deflate into scratch, so the kept buffer's capacity is the packed size
+                // rather than compressBound of the raw frame
+                size_t bytes = (size_t)slot.width * slot.height * pixel_size(slot.format);
+                packed.resize(compressBound(bytes));
+                uLongf packed_size = packed.size();
+                compress2(packed.data(), &packed_size, slot.pixels.data(), bytes, Z_BEST_SPEED);
+                rec.packed.assign(packed.begin(), packed.begin() + packed_size);
+                rec.audio.assign(slot.audio.begin(), slot.audio.begin() + slot.audio_frames * 2);
+                rec.width = slot.width;
+                rec.height = slot.height;
+                rec.format = slot.format;
+
+                history_bytes += rec.packed.capacity() + rec.audio.capacity() * sizeof(int16_t);
+                history.push_back(std::move(rec));
+                while (history_bytes > g_record_memory_limit.load(std::memory_order_relaxed) && history.size() > 1)
+                {
+                    history_bytes -=
+                        history.front().packed.capacity() + history.front().audio.capacity() * sizeof(int16_t);
+                    history.pop_front();
+                }
+            }
+            g_capture_read.store(++read, std::memory_order_release);
+        }
+
+        if (dumps != g_record_dump_requests.load(std::memory_order_relaxed))
+        {
+            dumps = g_record_dump_requests.load(std::memory_order_relaxed);
+            // The dump gets the history; recording carries on into a fresh one
+            if (g_dump_thread.joinable())
+                g_dump_thread.join();
+            g_dump_thread = std::thread(dump_recording, std::move(history),
+                                        g_capture_dropped.load(std::memory_order_relaxed));
+            history = {};
+            history_bytes = 0;
+        }
+        memory_track(MEM_CAPTURE, int64_t(history_bytes) - int64_t(tracked_bytes));
+        tracked_bytes = history_bytes;
+
+        if (stopping)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    }
+}
+
+// Call once the game is loaded and the AV info is final.
+void start_capture(const struct retro_system_av_info &av_info, const std::string &rom_path)
+{
+    g_capture_fps = av_info.timing.fps > 0 ? av_info.timing.fps : 60.0;
+    g_capture_sample_rate = av_info.timing.sample_rate;
+    g_capture_name = std::filesystem::path(rom_path).stem().string();
+
+    size_t max_bytes = (size_t)std::max(av_info.geometry.max_width, av_info.geometry.base_width) *
+                       std::max(av_info.geometry.max_height, av_info.geometry.base_height) * 4;
+    size_t slot_bytes = (CAPTURE_SLOTS + 1) * (max_bytes + CAPTURE_AUDIO_FRAMES * 2 * sizeof(int16_t));
+    if (memory_grant(slot_bytes, slot_bytes) == 0)
+    {
+        std::cout << "[memory] Capture buffers (" << slot_bytes / 1048576 << " MB) don't fit the budget; "
+                  << "screenshots and recording are off" << std::endl;
+        g_record = false;
+        return;
+    }
+    if (g_record)
+    {
+        size_t limit = memory_grant(RECORD_MEMORY_MAX + slot_bytes, RECORD_MEMORY_MIN + slot_bytes);
+        if (limit == 0)
+        {
+            std::cout << "[memory] No room in the budget for a recording history; --record is off" << std::endl;
+            g_record = false;
+        }
+        else if (limit - slot_bytes < RECORD_MEMORY_MAX)
+        {
+            g_record_memory_limit.store(limit - slot_bytes, std::memory_order_relaxed);
+            std::cout << "[memory] Recording history capped at " << (limit - slot_bytes) / 1048576 << " MB"
+                      << std::endl;
+        }
+    }
+    for (CaptureSlot &slot : g_capture_slots)
+    {
+        memory_resize(MEM_CAPTURE, slot.pixels, max_bytes);
+        memory_resize(MEM_CAPTURE, slot.audio, CAPTURE_AUDIO_FRAMES * 2);
+    }
+    memory_resize(MEM_CAPTURE, g_capture_audio, CAPTURE_AUDIO_FRAMES * 2);
+    g_capture_thread = std::thread(capture_thread_main);
+    g_capture_started = true;
+}
+
+void stop_capture()
+{
+    if (!g_capture_started)
+        return;
+    g_capture_started = false;
+    g_capture_stop.store(true, std::memory_order_release);
+    g_capture_thread.join();
+    if (g_dump_thread.joinable())
+        g_dump_thread.join();
+    uint64_t dropped = g_capture_dropped.load(std::memory_order_relaxed);
+    if (dropped > 0)
+        std::cout << "[capture] " << dropped << " frames dropped" << std::endl;
+}
+
+// Once per frame: answers report requests and, over the budget, halves the recording history.
+void service_memory(const char *process)
+{
+    if (g_memory_reports != g_memory_report_requests)
+    {
+        g_memory_reports = g_memory_report_requests;
+        report_memory((std::string(process) + " on request").c_str());
+    }
+    // The recording history lives with the capture thread; the sandbox host only reports
+    static uint64_t frames = 0;
+    if (g_memory_budget == 0 || !g_capture_started || ++frames % MEMORY_CHECK_FRAMES != 0)
+        return;
+    size_t rss = session_rss();
+    size_t limit = g_record_memory_limit.load(std::memory_order_relaxed);
+    if (rss > g_memory_budget && g_record && limit > RECORD_MEMORY_MIN)
+    {
+        limit = std::max(limit / 2, RECORD_MEMORY_MIN);
+        g_record_memory_limit.store(limit, std::memory_order_relaxed);
+        std::cout << "[memory] RSS " << rss / 1048576 << " MB is over the budget; recording history cut to "
+                  << limit / 1048576 << " MB" << std::endl;
+    }
+}
+
+// --- Presentation ---
+// Software frames are uploaded into one texture, allocated for the core's maximum
+// geometry so that mode changes don't reallocate it, and drawn with a single
+// fullscreen-triangle pass into a viewport scaled from base_width/base_height and
+// aspect_ratio. Sharp-bilinear keeps pixels crisp at fractional scales by only
+// blending across the texel edges.
+
+enum PresentScale
+{
+    SCALE_ASPECT,  // Largest fit that keeps the display aspect ratio
+    SCALE_INTEGER, // Whole multiples of the frame height
+};
+
+enum PresentFilter
+{
+    FILTER_SHARP_BILINEAR,
+    FILTER_NEAREST,
+};
+
+const char *const PRESENT_VERTEX_SHADER = R"(#version 330 core
+out vec2 v_uv;
+void main()
+{
+    // (0,0), (2,0), (0,2): one triangle that covers the viewport
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    v_uv = vec2(pos.x, 1.0 - pos.y); // Row 0 of the frame at the top
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char *const PRESENT_FRAGMENT_SHADER = R"(#version 330 core
+uniform sampler2D u_frame;
+uniform vec2 u_source_size;  // Frame size in texels
+uniform vec2 u_texture_size; // Allocated texture size
+uniform vec2 u_scale;        // Output pixels per texel
+uniform int u_sharp;
+in vec2 v_uv;
+out vec4 frag_color;
+void main()
+{
+    vec2 texel = v_uv * u_source_size;
+    if (u_sharp != 0)
+    {
+        // Flat inside each texel, a one-output-pixel linear ramp across its edge
+        vec2 region = max(0.5 - 0.5 / u_scale, 0.0); // Plain bilinear when downscaling
+        vec2 center = fract(texel) - 0.5;
+        texel = floor(texel) + (center - clamp(center, -region, region)) * u_scale + 0.5;
+    }
+    texel = clamp(texel, vec2(0.5), u_source_size - 0.5); // Stay inside this frame's part of the texture
+    frag_color = vec4(texture(u_frame, texel / u_texture_size).rgb, 1.0);
+}
+)";
+
+struct retro_system_av_info g_av_info = {}; // Geometry follows SET_GEOMETRY/SET_SYSTEM_AV_INFO
+PresentScale g_present_scale = SCALE_ASPECT;
+PresentFilter g_present_filter = FILTER_SHARP_BILINEAR;
+GLuint g_present_program = 0;
+GLuint g_present_vao = 0;
+GLuint g_present_texture = 0;
+GLint g_uniform_source_size = -1;
+GLint g_uniform_texture_size = -1;
+GLint g_uniform_scale = -1;
+GLint g_uniform_sharp = -1;
+unsigned g_texture_width = 0; // Allocated size
+unsigned g_texture_height = 0;
+enum retro_pixel_format g_texture_format = RETRO_PIXEL_FORMAT_UNKNOWN;
+unsigned g_frame_width = 0; // Size of the frame currently in the texture
+unsigned g_frame_height = 0;
+
+// Per-run presentation cost
+uint64_t g_present_frames = 0;
+uint64_t g_upload_ns = 0;
+uint64_t g_draw_ns = 0;
+
+static GLuint compile_shader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        throw std::runtime_error("Failed to compile presentation shader: " + std::string(log));
+    }
+    return shader;
+}
+
+// Needs the GL context. The texture is allocated on the first frame.
+void init_presenter()
+{
+    GLuint vertex = compile_shader(GL_VERTEX_SHADER, PRESENT_VERTEX_SHADER);
+    GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, PRESENT_FRAGMENT_SHADER);
+    g_present_program = glCreateProgram();
+    glAttachShader(g_present_program, vertex);
+    glAttachShader(g_present_program, fragment);
+    glLinkProgram(g_present_program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    GLint ok = 0;
+    glGetProgramiv(g_present_program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        char log[1024];
+        glGetProgramInfoLog(g_present_program, sizeof(log), nullptr, log);
+        throw std::runtime_error("Failed to link presentation shader: " + std::string(log));
+    }
+
+    glUseProgram(g_present_program);
+    glUniform1i(glGetUniformLocation(g_present_program, "u_frame"), 0);
+    g_uniform_source_size = glGetUniformLocation(g_present_program, "u_source_size");
+    g_uniform_texture_size = glGetUniformLocation(g_present_program, "u_texture_size");
+    g_uniform_scale = glGetUniformLocation(g_present_program, "u_scale");
+    g_uniform_sharp = glGetUniformLocation(g_present_program, "u_sharp");
+
+    glGenVertexArrays(1, &g_present_vao); // Core profile needs one bound, even without attributes
+    glBindVertexArray(g_present_vao);
+    glGenTextures(1, &g_present_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, g_present_texture);
+}
+
+// Reallocates the texture only when a frame doesn't fit or the pixel format changed.
+static void ensure_texture(unsigned width, unsigned height)
+{
+    if (g_pixel_format == g_texture_format && width <= g_texture_width && height <= g_texture_height)
+        return;
+
+    int64_t old_bytes = (int64_t)g_texture_width * g_texture_height * pixel_size(g_texture_format);
+    g_texture_width = std::max({width, g_av_info.geometry.max_width, g_texture_width});
+    g_texture_height = std::max({height, g_av_info.geometry.max_height, g_texture_height});
+    g_texture_format = g_pixel_format;
+    memory_track(MEM_TEXTURE, (int64_t)g_texture_width * g_texture_height * pixel_size(g_texture_format) - old_bytes);
+
+    GLenum internal = g_pixel_format == RETRO_PIXEL_FORMAT_XRGB8888 ? GL_RGBA8
+                      : g_pixel_format == RETRO_PIXEL_FORMAT_RGB565 ? GL_RGB565
+                                                                    : GL_RGB5_A1;
+    glTexImage2D(GL_TEXTURE_2D, 0, internal, g_texture_width, g_texture_height, 0, GL_RGB,
+                 GL_UNSIGNED_SHORT_5_6_5, nullptr);
+    std::cout << "[present] Texture " << g_texture_width << "x" << g_texture_height << std::endl;
+}
+
+// Uploads a software frame. Called from the video callback.
+void upload_frame(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+    uint64_t start = now_ns();
+    ensure_texture(width, height);
+
+    GLenum format = GL_RGB, type = GL_UNSIGNED_SHORT_5_6_5;
+    if (g_pixel_format == RETRO_PIXEL_FORMAT_XRGB8888)
+    {
+        format = GL_BGRA;
+        type = GL_UNSIGNED_INT_8_8_8_8_REV;
+    }
+    else if (g_pixel_format == RETRO_PIXEL_FORMAT_0RGB1555)
+    {
+        format = GL_BGRA;
+        type = GL_UNSIGNED_SHORT_1_5_5_5_REV;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, pixel_size(g_pixel_format));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / pixel_size(g_pixel_format));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data);
+
+    g_frame_width = width;
+    g_frame_height = height;
+    g_upload_ns += now_ns() - start;
+}
+
+// Draws the current texture into the window. Call once per frame before swapping;
+// duped frames just redraw it.
+void present_frame()
+{
+    if (g_frame_width == 0)
+        return;
+    uint64_t start = now_ns();
+
+    int window_w, window_h;
+    SDL_GL_GetDrawableSize(g_window, &window_w, &window_h);
+
+    const struct retro_game_geometry &geometry = g_av_info.geometry;
+    double aspect = geometry.aspect_ratio > 0 ? geometry.aspect_ratio
+                    : geometry.base_height  ? (double)geometry.base_width / geometry.base_height
+                                            : (double)g_frame_width / g_frame_height;
+    int out_w, out_h;
+    if (g_present_scale == SCALE_INTEGER && (int)g_frame_height <= window_h)
+    {
+        int factor = window_h / g_frame_height;
+        while (factor > 1 && g_frame_height * factor * aspect > window_w)
+            factor--;
+        out_h = g_frame_height * factor;
+        out_w = (int)(out_h * aspect + 0.5);
+    }
+    else
+    {
+        out_w = std::min(window_w, (int)(window_h * aspect + 0.5));
+        out_h = std::min(window_h, (int)(out_w / aspect + 0.5));
+    }
+
+    glViewport(0, 0, window_w, window_h);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glViewport((window_w - out_w) / 2, (window_h - out_h) / 2, out_w, out_h);
+
+    GLint filter = g_present_filter == FILTER_NEAREST ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glUniform2f(g_uniform_source_size, g_frame_width, g_frame_height);
+    glUniform2f(g_uniform_texture_size, g_texture_width, g_texture_height);
+    glUniform2f(g_uniform_scale, (float)out_w / g_frame_width, (float)out_h / g_frame_height);
+    glUniform1i(g_uniform_sharp, g_present_filter == FILTER_SHARP_BILINEAR);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    g_present_frames++;
+    g_draw_ns += now_ns() - start;
+}
+
+void report_present_stats()
+{
+    if (g_present_frames == 0)
+        return;
+    std::cout << "[present] " << g_present_frames << " frames, "
+              << (g_present_filter == FILTER_NEAREST ? "nearest" : "sharp-bilinear") << ", "
+              << (g_present_scale == SCALE_INTEGER ? "integer" : "aspect") << " scaling: upload "
+              << g_upload_ns / 1000.0 / g_present_frames << " us, draw " << g_draw_ns / 1000.0 / g_present_frames
+              << " us per frame (CPU side)" << std::endl;
+}
+
+// --- Performance Profiles ---
+// Each session records, per core and ROM CRC, how expensive retro_run was relative to
+// the frame budget, how often a vsync was missed and how often the audio queue ran
+// dry. The next launch of the same game picks its audio buffer, swap interval and
+// frame skipping from that history: light games get the lowest latency, demanding
+// ones the safe settings. Older sessions are decayed so the profile follows changes.
+
+constexpr int PROFILE_BUCKETS = 32;             // retro_run cost in 1/16ths of a frame; the last bucket is 2x and up
+constexpr uint64_t PROFILE_WARMUP_FRAMES = 120; // Loading hitches aren't the game's steady state
+constexpr double PROFILE_MIN_FRAMES = 600;      // Less history than this keeps the defaults
+constexpr double PROFILE_DECAY = 0.5;           // Weight of the previous history when a session is merged
+
+struct PerfProfile
+{
+    unsigned sessions = 0;
+    double frames = 0;
+    double missed_vsyncs = 0;
+    double underruns = 0;
+    double run_cost[PROFILE_BUCKETS] = {0};
+};
+
+PerfProfile g_profile; // History loaded at launch
+PerfProfile g_session; // This session
+std::string g_profile_key;
+unsigned g_audio_samples = 1024; // SDL device buffer
+int g_swap_interval = 1;         // -1 is adaptive vsync
+bool g_frame_skip = false;       // Skip presenting a frame after a late one
+uint64_t g_last_swap_ns = 0;
+uint64_t g_profile_frames = 0;
+bool g_frame_late = false;
+bool g_skipped_present = false;
+bool g_presented_last = false;
+
+static std::string profile_db_path()
+{
+    const char *home = getenv("HOME");
+    return (std::filesystem::path(home ? home : "/tmp") / ".local/share/dendy/profiles.db").string();
+}
+
+// Fraction of the frame budget below which the given share of frames finished.
+static double profile_percentile(const PerfProfile &profile, double share)
+{
+    double total = 0;
+    for (double count : profile.run_cost)
+        total += count;
+    double seen = 0;
+    for (int i = 0; i < PROFILE_BUCKETS; ++i)
+    {
+        seen += profile.run_cost[i];
+        if (seen >= total * share)
+            return (i + 1) / 16.0;
+    }
+    return PROFILE_BUCKETS / 16.0;
+}
+
+// Looks up the game's history and chooses this launch's settings. Needs g_rom_crc.
+void load_perf_profile()
+{
+    char key[128];
+    snprintf(key, sizeof(key), "%s %08x", g_option_core.c_str(), g_rom_crc);
+    g_profile_key = key;
+
+    std::ifstream db(profile_db_path());
+    std::string line;
+    while (std::getline(db, line))
+    {
+        if (line.compare(0, g_profile_key.size() + 1, g_profile_key + " ") != 0)
+            continue;
+        std::istringstream fields(line.substr(g_profile_key.size()));
+        fields >> g_profile.sessions >> g_profile.frames >> g_profile.missed_vsyncs >> g_profile.underruns;
+        for (double &count : g_profile.run_cost)
+            fields >> count;
+        break;
+    }
+
+    if (g_profile.frames < PROFILE_MIN_FRAMES)
+    {
+        std::cout << "[profile] No history for " << g_profile_key << ", using defaults" << std::endl;
+        return;
+    }
+
+    double p95 = profile_percentile(g_profile, 0.95);
+    double p99 = profile_percentile(g_profile, 0.99);
+    double missed = g_profile.missed_vsyncs / g_profile.frames;
+    double underruns = g_profile.underruns / g_profile.frames;
+    const char *verdict = "balanced";
+    if (p95 > 0.8 || missed > 0.05 || underruns > 0.02)
+    {
+        verdict = "demanding";
+        g_audio_samples = 2048;
+        g_swap_interval = -1;
+        g_frame_skip = true;
+    }
+    else if (p99 <= 0.5 && missed < 0.01 && underruns < 0.005)
+    {
+        verdict = "light";
+        g_audio_samples = 512;
+    }
+    std::cout << "[profile] " << g_profile_key << " is " << verdict << " (p95 " << p95 * 100 << "%, p99 " << p99 * 100
+              << "% of frame, " << missed * 100 << "% missed vsyncs, " << underruns * 100 << "% underruns over "
+              << g_profile.sessions << " sessions): audio " << g_audio_samples << ", swap interval " << g_swap_interval
+              << ", frame skip " << (g_frame_skip ? "on" : "off") << std::endl;
+}
+
+// Loads the profile and applies the swap interval; init_audio picks up the buffer size.
+void apply_perf_profile()
+{
+    load_perf_profile();
+    if (SDL_GL_SetSwapInterval(g_swap_interval) != 0 && g_swap_interval == -1)
+    {
+        // No adaptive vsync on this driver; frame skipping still covers late frames
+        g_swap_interval = 1;
+        SDL_GL_SetSwapInterval(1);
+    }
+}
+
+// Called after every frame with the time spent in retro_run.
+void record_frame_timing(uint64_t run_ns)
+{
+    uint64_t now = now_ns();
+    if (g_last_swap_ns == 0)
+        g_last_swap_ns = now;
+    double budget_ns = 1e9 / (g_av_info.timing.fps > 0 ? g_av_info.timing.fps : 60.0);
+    bool presented = !g_skipped_present;
+    uint64_t interval = now - g_last_swap_ns;
+    // Only back-to-back presents tell us about vsync; a skipped frame in between stretches the interval
+    bool missed = presented && g_presented_last && interval > budget_ns * 1.5;
+    if (presented)
+        g_last_swap_ns = now;
+    g_presented_last = presented;
+    // A late frame lets the next one skip presentation to catch up
+    g_frame_late = run_ns > budget_ns || missed;
+
+    if (++g_profile_frames <= PROFILE_WARMUP_FRAMES)
+        return;
+    g_session.frames++;
+    g_session.run_cost[std::min<int>(run_ns * 16 / budget_ns, PROFILE_BUCKETS - 1)]++;
+    if (missed)
+        g_session.missed_vsyncs++;
+    if (g_audio_callback.callback ? g_audio_pull_underruns.exchange(0) > 0
+                                  : g_audio_device > 0 && SDL_GetQueuedAudioSize(g_audio_device) == 0)
+        g_session.underruns++;
+}
+
+// With frame skip on, a frame after a late one isn't presented, at most every other frame.
+bool should_present_frame()
+{
+    g_skipped_present = g_frame_skip && g_frame_late && !g_skipped_present;
+    return !g_skipped_present;
+}
+
+// Merges this session into the database. Short sessions are ignored.
+void save_perf_profile()
+{
+    if (g_profile_key.empty() || g_session.frames < PROFILE_MIN_FRAMES)
+        return;
+
+    PerfProfile merged;
+    merged.sessions = g_profile.sessions + 1;
+    merged.frames = g_profile.frames * PROFILE_DECAY + g_session.frames;
+    merged.missed_vsyncs = g_profile.missed_vsyncs * PROFILE_DECAY + g_session.missed_vsyncs;
+    merged.underruns = g_profile.underruns * PROFILE_DECAY + g_session.underruns;
+    for (int i = 0; i < PROFILE_BUCKETS; ++i)
+        merged.run_cost[i] = g_profile.run_cost[i] * PROFILE_DECAY + g_session.run_cost[i];
+
+    std::ostringstream entry;
+    entry << g_profile_key << " " << merged.sessions << " " << merged.frames << " " << merged.missed_vsyncs << " "
+          << merged.underruns;
+    for (double count : merged.run_cost)
+        entry << " " << count;
+
+    std::string path = profile_db_path();
+    std::vector<std::string> lines;
+    std::ifstream db(path);
+    std::string line;
+    while (std::getline(db, line))
+    {
+        if (!line.empty() && line.compare(0, g_profile_key.size() + 1, g_profile_key + " ") != 0)
+            lines.push_back(line);
+    }
+    db.close();
+    lines.push_back(entry.str());
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::trunc);
+    for (const auto &l : lines)
+        out << l << "\n";
+    out.close();
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "[profile] Failed to write " << path << std::endl;
+        return;
+    }
+    std::cout << "[profile] Recorded " << (uint64_t)g_session.frames << " frames: p99 "
+              << profile_percentile(g_session, 0.99) * 100 << "% of frame, " << g_session.missed_vsyncs
+              << " missed vsyncs, " << g_session.underruns << " underruns" << std::endl;
+}
+
+// --- Core Timing ---
+// Cores that set SET_FRAME_TIME_CALLBACK are told the measured time between retro_run
+// calls. While fast-forwarding (Tab held), benchmarking or in netplay they get the
+// reference interval instead, so a run is reproducible. Cores that set
+// SET_AUDIO_CALLBACK produce audio when SDL's audio thread runs short rather than once
+// per frame, so the device buffer is the only queue between them and the speaker.
+
+constexpr unsigned FAST_FORWARD_PRESENT_EVERY = 4; // Frames per present while unthrottled
+constexpr unsigned AUDIO_PULL_MAX_CALLS = 8;       // Core callbacks per SDL request before padding with silence
+constexpr size_t AUDIO_PULL_MAX_SAMPLES = 16384 * 2;
+
+struct retro_frame_time_callback g_frame_time = {};
+uint64_t g_last_frame_time_ns = 0;
+bool g_fast_forward = false; // Tab held
+bool g_benchmark = false;    // --benchmark: unthrottled for the whole session
+bool g_unthrottled = false;  // Either of the above, as last applied
+uint64_t g_unthrottled_frames = 0;
+uint64_t g_benchmark_start_ns = 0;
+std::vector<int16_t> g_audio_pull; // Core audio not yet handed to SDL; guarded by the device lock
+thread_local bool g_audio_pulling = false;
+
+// Use instead of core_retro_run.
+void run_core_frame(bool fixed_delta)
+{
+    if (g_frame_time.callback)
+    {
+        uint64_t now = now_ns();
+        retro_usec_t delta = g_frame_time.reference;
+        if (!fixed_delta && g_last_frame_time_ns)
+            delta = (now - g_last_frame_time_ns) / 1000;
+        g_last_frame_time_ns = now;
+        g_frame_time.callback(delta);
+    }
+    core_retro_run();
+}
+
+// Audio from an audio-callback core. On SDL's thread the device lock is already held.
+void audio_pull_append(const int16_t *data, size_t frames)
+{
+    if (!g_audio_pulling)
+        SDL_LockAudioDevice(g_audio_device);
+    size_t room = AUDIO_PULL_MAX_SAMPLES - std::min(AUDIO_PULL_MAX_SAMPLES, g_audio_pull.size());
+    g_audio_pull.insert(g_audio_pull.end(), data, data + std::min(frames * 2, room));
+    if (!g_audio_pulling)
+        SDL_UnlockAudioDevice(g_audio_device);
+}
+
+// SDL audio thread, whenever the device needs len more bytes.
+void audio_pull_callback(void * /*userdata*/, Uint8 *stream, int len)
+{
+    size_t wanted = len / sizeof(int16_t);
+    g_audio_pulling = true;
+    for (unsigned calls = 0; g_audio_pull.size() < wanted && calls < AUDIO_PULL_MAX_CALLS; ++calls)
+        g_audio_callback.callback();
+    g_audio_pulling = false;
+
+    size_t have = std::min(wanted, g_audio_pull.size());
+    std::memcpy(stream, g_audio_pull.data(), have * sizeof(int16_t));
+    std::memset(stream + have * sizeof(int16_t), 0, (wanted - have) * sizeof(int16_t));
+    g_audio_pull.erase(g_audio_pull.begin(), g_audio_pull.begin() + have);
+    if (have < wanted)
+        g_audio_pull_underruns++;
+}
+
+// Once the game is loaded and the device is open in pull mode; the core may
+// register the callback in retro_init, before it has anything to play.
+void start_audio_callback()
+{
+    if (!g_audio_callback.callback || g_audio_device == 0)
+        return;
+    if (g_audio_callback.set_state)
+        g_audio_callback.set_state(true);
+}
+
+// Before the core unloads, so the audio thread stops calling into it.
+void stop_audio_callback()
+{
+    if (!g_audio_callback.callback || g_audio_device == 0)
+        return;
+    SDL_PauseAudioDevice(g_audio_device, 1); // Returns once no callback is in flight
+    if (g_audio_callback.set_state)
+        g_audio_callback.set_state(false);
+}
+
+// Once per frame: switches vsync and audio off while fast-forwarding or benchmarking.
+void update_throttle()
+{
+    bool unthrottled = g_fast_forward || g_benchmark;
+    if (unthrottled == g_unthrottled)
+        return;
+    g_unthrottled = unthrottled;
+    if (unthrottled)
+    {
+        SDL_GL_SetSwapInterval(0);
+        if (!g_audio_callback.callback)
+            SDL_ClearQueuedAudio(g_audio_device);
+        if (g_benchmark)
+            g_benchmark_start_ns = now_ns();
+    }
+    else if (SDL_GL_SetSwapInterval(g_swap_interval) != 0)
+    {
+        SDL_GL_SetSwapInterval(1);
+    }
+}
+
+// Replaces should_present_frame in the main loops; unthrottled, only every few frames are shown.
+bool throttle_present()
+{
+    if (!g_unthrottled)
+        return should_present_frame();
+    return ++g_unthrottled_frames % FAST_FORWARD_PRESENT_EVERY == 0;
+}
+
+void report_benchmark()
+{
+    if (!g_benchmark || g_unthrottled_frames == 0)
+        return;
+    double seconds = (now_ns() - g_benchmark_start_ns) / 1e9;
+    std::cout << "[benchmark] " << g_unthrottled_frames << " frames in " << seconds << " s: "
+              << g_unthrottled_frames / seconds << " fps (" << g_unthrottled_frames / seconds / g_av_info.timing.fps
+              << "x real time)" << std::endl;
+}
+
+// --- RAM Watch ---
+// Achievement and auto-splitter style "address compare value" conditions, evaluated
+// after every frame. Core addresses are translated through the SET_MEMORY_MAPS
+// descriptors (or SYSTEM_RAM at address 0 if the core sends none), flattened into a
+// page table. Conditions are compiled to host pointers once, so a frame's evaluation
+// is four-wide AVX2 gathers and compares, with a scalar path for other CPUs and for
+// conditions the gather can't read safely (big-endian or near the end of a region).
+
+constexpr unsigned WATCH_PAGE_BITS = 12;
+constexpr uint64_t WATCH_TABLE_MAX = 1ull << 28; // Addresses above this go through the descriptor walk
+constexpr double WATCH_BUDGET_US = 50.0;         // Per frame, for WATCH_BENCH_CONDITIONS conditions
+constexpr size_t WATCH_BENCH_CONDITIONS = 1000;
+
+enum WatchOp : uint8_t
+{
+    WATCH_EQ,
+    WATCH_NE,
+    WATCH_LT,
+    WATCH_LE,
+    WATCH_GT,
+    WATCH_GE,
+};
+
+struct WatchCondition
+{
+    uint32_t address;
+    uint8_t bytes; // 1, 2 or 4
+    WatchOp op;
+    uint32_t value;
+};
+
+struct MemoryPage
+{
+    uint8_t *host;    // Host address of the page's first byte, if the page maps linearly
+    size_t available; // Bytes readable from host onwards
+    bool slow;        // Mapped, but not linearly (small mirrors, disconnected low bits)
+};
+
+// Compiled conditions, structure-of-arrays and padded to a multiple of four
+struct WatchProgram
+{
+    size_t count = 0;
+    const uint8_t *base = nullptr;   // Lowest host pointer; offsets are relative to it
+    std::vector<int64_t> offsets;    // Host pointer - base
+    std::vector<uint32_t> masks;     // Value mask for the condition's size
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> want_lt;   // All ones if the op accepts "less than"
+    std::vector<uint32_t> want_eq;
+    std::vector<uint32_t> want_gt;
+    std::vector<uint32_t> scalar;    // Conditions the gather can't read; fixed up afterwards
+    std::vector<const uint8_t *> pointers; // nullptr for unmapped addresses (always false)
+    std::vector<bool> big_endian;
+};
+
+std::vector<struct retro_memory_descriptor> g_memory_descriptors; // Preprocessed copies
+std::vector<MemoryPage> g_memory_pages;
+std::string g_watch_file;  // --watch
+bool g_watch_bench = false; // --watch-bench
+std::vector<WatchCondition> g_watch_conditions;
+std::vector<std::string> g_watch_text;
+WatchProgram g_watch_program;
+std::vector<uint8_t> g_watch_results;
+std::vector<uint8_t> g_watch_previous;
+uint64_t g_watch_frames = 0;
+uint64_t g_watch_ns = 0;
+uint64_t g_watch_worst_ns = 0;
+const uint32_t g_watch_zero = 0; // Gather target for lanes handled by the scalar path
+
+// Bit helpers from the libretro memory map specification
+static size_t add_bits_down(size_t n)
+{
+    n |= n >> 1;
+    n |= n >> 2;
+    n |= n >> 4;
+    n |= n >> 8;
+    n |= n >> 16;
+    if (sizeof(size_t) > 4)
+        n |= n >> 16 >> 16;
+    return n;
+}
+
+static size_t inflate_bits(size_t addr, size_t mask)
+{
+    while (mask)
+    {
+        size_t tmp = (mask - 1) & ~mask;
+        addr = ((addr & ~tmp) << 1) | (addr & tmp);
+        mask = mask & (mask - 1);
+    }
+    return addr;
+}
+
+static size_t reduce_bits(size_t addr, size_t mask)
+{
+    while (mask)
+    {
+        size_t tmp = (mask - 1) & ~mask;
+        addr = (addr & tmp) | ((addr >> 1) & ~tmp);
+        mask = (mask & (mask - 1)) >> 1;
+    }
+    return addr;
+}
+
+static size_t highest_bit(size_t n)
+{
+    n = add_bits_down(n);
+    return n ^ (n >> 1);
+}
+
+// Fills in select/len/disconnect the way the specification derives them.
+bool set_memory_maps(const struct retro_memory_map *map)
+{
+    std::vector<struct retro_memory_descriptor> descs(map->descriptors, map->descriptors + map->num_descriptors);
+    size_t top_addr = 1;
+    for (const auto &desc : descs)
+        top_addr |= desc.select ? desc.select : desc.start + desc.len - 1;
+    top_addr = add_bits_down(top_addr);
+
+    for (auto &desc : descs)
+    {
+        if (desc.select == 0)
+        {
+            if (desc.len == 0 || (desc.len & (desc.len - 1)) != 0)
+                return false; // Needs a power of two to derive select
+            desc.select = top_addr & ~inflate_bits(add_bits_down(desc.len - 1), desc.disconnect);
+        }
+        if (desc.len == 0)
+            desc.len = add_bits_down(reduce_bits(top_addr & ~desc.select, desc.disconnect)) + 1;
+        if (desc.start & ~desc.select)
+            return false;
+        while (reduce_bits(top_addr & ~desc.select, desc.disconnect) >> 1 > desc.len - 1)
+            desc.disconnect |= highest_bit(top_addr & ~desc.select & ~desc.disconnect);
+    }
+    g_memory_descriptors = std::move(descs);
+    return true;
+}
+
+// Descriptor walk for one address. Sets available to the bytes readable from the result.
+static uint8_t *resolve_slow(size_t address, size_t &available)
+{
+    for (const auto &desc : g_memory_descriptors)
+    {
+        if (((desc.start ^ address) & desc.select) != 0)
+            continue;
+        if (!desc.ptr)
+            return nullptr;
+        size_t offset = reduce_bits(address & ~desc.select, desc.disconnect);
+        if (offset >= desc.len)
+            offset -= highest_bit(offset);
+        available = desc.len - offset;
+        return static_cast<uint8_t *>(desc.ptr) + desc.offset + offset;
+    }
+    return nullptr;
+}
+
+// Flattens the descriptors into WATCH_PAGE_BITS pages.
+void build_memory_pages()
+{
+    size_t top = 0;
+    for (const auto &desc : g_memory_descriptors)
+        top = std::max(top, desc.start + desc.len);
+    top = std::min<uint64_t>(add_bits_down(std::max<size_t>(top, 1) - 1) + 1, WATCH_TABLE_MAX);
+
+    const size_t page_size = size_t(1) << WATCH_PAGE_BITS;
+    g_memory_pages.assign((top + page_size - 1) >> WATCH_PAGE_BITS, MemoryPage{nullptr, 0, false});
+    for (size_t page = 0; page < g_memory_pages.size(); ++page)
+    {
+        size_t address = page << WATCH_PAGE_BITS;
+        size_t available = 0;
+        uint8_t *host = resolve_slow(address, available);
+        if (!host)
+            continue;
+        // Linear only if the last byte of the page lands where the first one predicts
+        size_t last_available = 0;
+        uint8_t *last = resolve_slow(address + page_size - 1, last_available);
+        if (available >= page_size && last == host + page_size - 1)
+            g_memory_pages[page] = MemoryPage{host, available, false};
+        else
+            g_memory_pages[page] = MemoryPage{nullptr, 0, true};
+    }
+}
+
+static const uint8_t *resolve_address(uint32_t address, size_t &available)
+{
+    size_t page = address >> WATCH_PAGE_BITS;
+    if (page < g_memory_pages.size() && !g_memory_pages[page].slow)
+    {
+        const MemoryPage &entry = g_memory_pages[page];
+        if (!entry.host)
+            return nullptr;
+        size_t within = address & ((size_t(1) << WATCH_PAGE_BITS) - 1);
+        available = entry.available - within;
+        return entry.host + within;
+    }
+    return resolve_slow(address, available);
+}
+
+static bool big_endian_at(uint32_t address)
+{
+    for (const auto &desc : g_memory_descriptors)
+    {
+        if (((desc.start ^ address) & desc.select) == 0)
+            return desc.flags & RETRO_MEMDESC_BIGENDIAN;
+    }
+    return false;
+}
+
+WatchProgram compile_watch(const std::vector<WatchCondition> &conditions)
+{
+    WatchProgram program;
+    program.count = conditions.size();
+    size_t padded = (conditions.size() + 3) & ~size_t(3);
+    program.pointers.assign(conditions.size(), nullptr);
+    program.big_endian.assign(conditions.size(), false);
+
+    std::vector<size_t> available(conditions.size(), 0);
+    program.base = reinterpret_cast<const uint8_t *>(&g_watch_zero);
+    for (size_t i = 0; i < conditions.size(); ++i)
+    {
+        program.pointers[i] = resolve_address(conditions[i].address, available[i]);
+        program.big_endian[i] = big_endian_at(conditions[i].address);
+        if (program.pointers[i])
+            program.base = std::min(program.base, program.pointers[i]);
+    }
+
+    program.offsets.assign(padded, reinterpret_cast<const uint8_t *>(&g_watch_zero) - program.base);
+    program.masks.assign(padded, 0);
+    program.values.assign(padded, 0);
+    program.want_lt.assign(padded, 0);
+    program.want_eq.assign(padded, 0);
+    program.want_gt.assign(padded, 0);
+    for (size_t i = 0; i < conditions.size(); ++i)
+    {
+        const WatchCondition &cond = conditions[i];
+        program.masks[i] = cond.bytes == 4 ? 0xffffffffu : (1u << (cond.bytes * 8)) - 1;
+        program.values[i] = cond.value & program.masks[i];
+        program.want_lt[i] = (cond.op == WATCH_NE || cond.op == WATCH_LT || cond.op == WATCH_LE) ? ~0u : 0;
+        program.want_eq[i] = (cond.op == WATCH_EQ || cond.op == WATCH_LE || cond.op == WATCH_GE) ? ~0u : 0;
+        program.want_gt[i] = (cond.op == WATCH_NE || cond.op == WATCH_GT || cond.op == WATCH_GE) ? ~0u : 0;
+
+        // The gather always reads four bytes
+        if (program.pointers[i] && available[i] >= 4 && !program.big_endian[i])
+            program.offsets[i] = program.pointers[i] - program.base;
+        else
+            program.scalar.push_back(i);
+    }
+    return program;
+}
+
+static bool watch_eval_one(const WatchProgram &program, size_t i)
+{
+    const uint8_t *ptr = program.pointers[i];
+    if (!ptr)
+        return false;
+    uint32_t value = 0;
+    unsigned bytes = program.masks[i] == 0xff ? 1 : program.masks[i] == 0xffff ? 2 : 4;
+    for (unsigned b = 0; b < bytes; ++b)
+        value |= uint32_t(ptr[b]) << (8 * (program.big_endian[i] ? bytes - 1 - b : b));
+    uint32_t ref = program.values[i];
+    return (value < ref && program.want_lt[i]) || (value == ref && program.want_eq[i]) ||
+           (value > ref && program.want_gt[i]);
+}
+
+void watch_eval_scalar(const WatchProgram &program, uint8_t *results)
+{
+    for (size_t i = 0; i < program.count; ++i)
+        results[i] = watch_eval_one(program, i);
+}
+
+#ifdef __x86_64__
+__attribute__((target("avx2"))) void watch_eval_avx2(const WatchProgram &program, uint8_t *results)
+{
+    const __m128i bias = _mm_set1_epi32(INT32_MIN); // Unsigned compares via signed ones
+    const int *base = reinterpret_cast<const int *>(program.base);
+    size_t padded = program.offsets.size();
+    for (size_t i = 0; i < padded; i += 4)
+    {
+        __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&program.offsets[i]));
+        __m128i value = _mm256_i64gather_epi32(base, offsets, 1);
+        value = _mm_and_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&program.masks[i])));
+        __m128i ref = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&program.values[i]));
+
+        __m128i eq = _mm_cmpeq_epi32(value, ref);
+        __m128i gt = _mm_cmpgt_epi32(_mm_xor_si128(value, bias), _mm_xor_si128(ref, bias));
+        __m128i lt = _mm_andnot_si128(_mm_or_si128(eq, gt), _mm_set1_epi32(-1));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(lt, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&program.want_lt[i]))),
+                         _mm_and_si128(eq, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&program.want_eq[i])))),
+            _mm_and_si128(gt, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&program.want_gt[i]))));
+
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+        size_t lanes = std::min<size_t>(4, program.count - std::min(program.count, i));
+        for (size_t lane = 0; lane < lanes; ++lane)
+            results[i + lane] = (mask >> lane) & 1;
+    }
+    for (uint32_t i : program.scalar)
+        results[i] = watch_eval_one(program, i);
+}
+#endif
+
+void watch_eval(const WatchProgram &program, uint8_t *results)
+{
+#ifdef __x86_64__
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+    {
+        watch_eval_avx2(program, results);
+        return;
+    }
+#endif
+    watch_eval_scalar(program, results);
+}
+
+// One condition per line: "<address> <8|16|32> <op> <value>", e.g. "0x7e0019 8 == 3".
+bool parse_watch_file(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "[watch] Can't open " << path << std::endl;
+        return false;
+    }
+    static const char *const OPS[] = {"==", "!=", "<", "<=", ">", ">="};
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number)
+    {
+        size_t hash = line.find('#');
+        std::istringstream fields(line.substr(0, hash));
+        std::string address, bits, op, value;
+        if (!(fields >> address))
+            continue;
+        fields >> bits >> op >> value;
+
+        WatchCondition cond = {};
+        cond.address = std::strtoul(address.c_str(), nullptr, 0);
+        cond.bytes = std::atoi(bits.c_str()) / 8;
+        cond.value = std::strtoul(value.c_str(), nullptr, 0);
+        auto found = std::find(std::begin(OPS), std::end(OPS), op);
+        if ((cond.bytes != 1 && cond.bytes != 2 && cond.bytes != 4) || found == std::end(OPS) || value.empty())
+        {
+            std::cerr << "[watch] " << path << ":" << number << ": expected \"<address> <8|16|32> <op> <value>\""
+                      << std::endl;
+            continue;
+        }
+        cond.op = static_cast<WatchOp>(found - std::begin(OPS));
+        g_watch_conditions.push_back(cond);
+        std::string text = line.substr(0, hash);
+        text.erase(text.find_last_not_of(" \t\r") + 1);
+        g_watch_text.push_back(text);
+    }
+    return true;
+}
+
+// Random conditions over the mapped pages, checked against the scalar path and timed.
+void run_watch_bench()
+{
+    std::vector<size_t> mapped;
+    for (size_t page = 0; page < g_memory_pages.size(); ++page)
+    {
+        if (g_memory_pages[page].host || g_memory_pages[page].slow)
+            mapped.push_back(page);
+    }
+    if (mapped.empty())
+    {
+        std::cout << "[watch] bench: the core exposes no memory" << std::endl;
+        return;
+    }
+
+    uint32_t seed = 12345;
+    auto next = [&]
+    { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+    std::vector<WatchCondition> conditions;
+    for (size_t i = 0; i < WATCH_BENCH_CONDITIONS; ++i)
+    {
+        WatchCondition cond;
+        cond.address = (mapped[next() % mapped.size()] << WATCH_PAGE_BITS) | (next() & ((1u << WATCH_PAGE_BITS) - 1));
+        cond.bytes = 1u << (next() % 3);
+        cond.op = static_cast<WatchOp>(next() % 6);
+        size_t available = 0;
+        const uint8_t *ptr = resolve_address(cond.address, available);
+        cond.value = ptr ? ptr[0] + (next() % 3) - 1 : 0; // Near the live value, so outcomes vary
+        conditions.push_back(cond);
+    }
+    WatchProgram program = compile_watch(conditions);
+
+    const int iterations = 2000;
+    std::vector<uint8_t> simd(program.count), scalar(program.count);
+    uint64_t simd_ns = 0, scalar_ns = 0, simd_worst = 0;
+    size_t mismatches = 0;
+    for (int it = 0; it < iterations; ++it)
+    {
+        uint64_t start = now_ns();
+        watch_eval(program, simd.data());
+        uint64_t mid = now_ns();
+        watch_eval_scalar(program, scalar.data());
+        scalar_ns += now_ns() - mid;
+        simd_ns += mid - start;
+        simd_worst = std::max(simd_worst, mid - start);
+        mismatches += simd != scalar;
+    }
+    double avg_us = simd_ns / 1000.0 / iterations;
+    std::cout << "[watch] bench: " << program.count << " conditions (" << program.scalar.size()
+              << " scalar-only), dispatch " << avg_us << " us avg / " << simd_worst / 1000.0 << " us worst, scalar "
+              << scalar_ns / 1000.0 / iterations << " us; " << mismatches << " mismatching runs; "
+              << (avg_us <= WATCH_BUDGET_US && mismatches == 0 ? "PASS" : "FAIL") << " (budget " << WATCH_BUDGET_US
+              << " us)" << std::endl;
+}
+
+// Call once the game is loaded, on the side that runs the core.
+void start_ram_watch()
+{
+    if (g_watch_file.empty() && !g_watch_bench)
+        return;
+
+    if (g_memory_descriptors.empty() && core_retro_get_memory_data)
+    {
+        // No memory map: expose SYSTEM_RAM at address 0
+        struct retro_memory_descriptor ram = {};
+        ram.ptr = core_retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM);
+        ram.len = core_retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM);
+        ram.select = ~add_bits_down(std::max<size_t>(ram.len, 1) - 1);
+        if (ram.ptr && ram.len)
+            g_memory_descriptors.push_back(ram);
+    }
+    build_memory_pages();
+
+    if (g_watch_bench)
+        run_watch_bench();
+    if (!g_watch_file.empty() && parse_watch_file(g_watch_file))
+    {
+        g_watch_program = compile_watch(g_watch_conditions);
+        g_watch_results.assign(g_watch_conditions.size(), 0);
+        g_watch_previous.assign(g_watch_conditions.size(), 0);
+        std::cout << "[watch] " << g_watch_conditions.size() << " conditions over " << g_memory_descriptors.size()
+                  << " memory descriptors" << std::endl;
+    }
+}
+
+// After every frame: evaluates the conditions and reports the ones that changed.
+void watch_frame()
+{
+    if (g_watch_conditions.empty())
+        return;
+    uint64_t start = now_ns();
+    watch_eval(g_watch_program, g_watch_results.data());
+    uint64_t elapsed = now_ns() - start;
+    g_watch_ns += elapsed;
+    g_watch_worst_ns = std::max(g_watch_worst_ns, elapsed);
+    g_watch_frames++;
+
+    for (size_t i = 0; i < g_watch_results.size(); ++i)
+    {
+        if (g_watch_results[i] != g_watch_previous[i])
+        {
+            std::cout << "[watch] frame " << g_frame_count << ": " << g_watch_text[i] << " -> "
+                      << (g_watch_results[i] ? "true" : "false") << std::endl;
+        }
+    }
+    g_watch_previous.swap(g_watch_results);
+}
+
+void report_watch_stats()
+{
+    if (g_watch_frames == 0)
+        return;
+    std::cout << "[watch] " << g_watch_conditions.size() << " conditions: " << g_watch_ns / 1000.0 / g_watch_frames
+              << " us avg, " << g_watch_worst_ns / 1000.0 << " us worst per frame" << std::endl;
+}
+
+// --- CPU Placement ---
+// Opt-in (--realtime) so background Waydroid and launcher work can't preempt the
+// core: the emulation thread is pinned to one CPU, SDL's audio thread is asked for
+// SCHED_FIFO (SDL falls back to RTKit on its own), and memory is locked so the core,
+// ROM and frame buffers never page out. Each step degrades to a warning without the
+// privilege, and sleep jitter is measured before and after so the gain is visible.
+
+constexpr int JITTER_SAMPLES = 200;
+constexpr long JITTER_SLEEP_NS = 1000000;
+
+bool g_realtime = false; // --realtime
+int g_pin_cpu = -1;      // --pin-cpu, or the last allowed CPU
+
+// Lateness of 1 ms sleeps on the calling thread: how long the scheduler keeps us waiting.
+void measure_sleep_jitter(const char *label)
+{
+    std::vector<uint64_t> late(JITTER_SAMPLES);
+    for (auto &sample : late)
+    {
+        uint64_t start = now_ns();
+        struct timespec delay = {0, JITTER_SLEEP_NS};
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &delay, nullptr);
+        uint64_t elapsed = now_ns() - start;
+        sample = elapsed > uint64_t(JITTER_SLEEP_NS) ? elapsed - JITTER_SLEEP_NS : 0;
+    }
+    std::sort(late.begin(), late.end());
+    std::cout << "[placement] Sleep jitter " << label << ": p50 " << late[JITTER_SAMPLES / 2] / 1000 << " us, p99 "
+              << late[JITTER_SAMPLES * 99 / 100] / 1000 << " us, max " << late.back() / 1000 << " us" << std::endl;
+}
+
+// Pins the calling thread and keeps helper threads off its CPU where possible;
+// see unpin_helper_thread.
+void pin_current_thread()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    int cpu = g_pin_cpu;
+    if (cpu < 0)
+    {
+        // CPU 0 tends to take the most interrupts, so default to the last one
+        for (int i = 0; i < CPU_SETSIZE; ++i)
+        {
+            if (CPU_ISSET(i, &allowed))
+                cpu = i;
+        }
+    }
+    if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+    {
+        std::cerr << "[placement] CPU " << cpu << " isn't available to this process; not pinning" << std::endl;
+        return;
+    }
+    if (CPU_COUNT(&allowed) == 1)
+        std::cout << "[placement] Only CPU " << cpu << " is available; pinning changes nothing" << std::endl;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0)
+    {
+        std::cerr << "[placement] Couldn't pin the emulation thread to CPU " << cpu << std::endl;
+        return;
+    }
+    std::cout << "[placement] Emulation thread pinned to CPU " << cpu << std::endl;
+
+    g_helper_cpus = allowed;
+    if (CPU_COUNT(&allowed) > 1)
+        CPU_CLR(cpu, &g_helper_cpus);
+    g_helper_cpus_set.store(true, std::memory_order_release);
+}
+
+static std::string proc_status_field(const char *field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind(field, 0) == 0)
+        {
+            size_t value = line.find_first_not_of(" \t", strlen(field));
+            return value == std::string::npos ? "" : line.substr(value);
+        }
+    }
+    return "";
+}
+
+// Locks what is mapped now. MCL_ONFAULT keeps large file mappings (VFS, disc images)
+// from being read in just to lock them. Without CAP_IPC_LOCK or a large enough
+// RLIMIT_MEMLOCK, only the given regions are locked.
+void lock_memory(const std::vector<std::pair<const void *, size_t>> &fallback)
+{
+    if (mlockall(MCL_CURRENT | MCL_ONFAULT) == 0 || (errno == EINVAL && mlockall(MCL_CURRENT) == 0))
+    {
+        std::cout << "[placement] Locked all current mappings (" << proc_status_field("VmLck:") << ")" << std::endl;
+        return;
+    }
+    std::cerr << "[placement] mlockall failed (" << strerror(errno) << "); locking only the ROM and frame buffers"
+              << std::endl;
+    for (const auto &region : fallback)
+    {
+        if (region.first && region.second && mlock(region.first, region.second) != 0)
+        {
+            std::cerr << "[placement] mlock of " << region.second / 1024 << " KB failed: " << strerror(errno)
+                      << std::endl;
+        }
+    }
+    std::cout << "[placement] Locked " << proc_status_field("VmLck:") << std::endl;
+}
+
+// SDL names its playback thread SDLAudioP<n>; reports which policy it ended up with.
+void report_audio_thread_policy()
+{
+    DIR *tasks = opendir("/proc/self/task");
+    if (!tasks)
+        return;
+    bool found = false;
+    while (struct dirent *entry = readdir(tasks))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::ifstream comm(std::string("/proc/self/task/") + entry->d_name + "/comm");
+        std::string name;
+        std::getline(comm, name);
+        if (name.rfind("SDLAudio", 0) != 0)
+            continue;
+        pid_t tid = std::atoi(entry->d_name);
+        int policy = sched_getscheduler(tid);
+        struct sched_param param = {};
+        sched_getparam(tid, &param);
+        const char *policy_name = policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER";
+        std::cout << "[placement] Audio thread " << name << ": " << policy_name << " priority "
+                  << param.sched_priority << std::endl;
+        if (policy != SCHED_FIFO && policy != SCHED_RR)
+            std::cerr << "[placement] No real-time audio (needs RLIMIT_RTPRIO or RTKit); keeping the normal policy"
+                      << std::endl;
+        found = true;
+    }
+    closedir(tasks);
+    if (!found)
+        std::cout << "[placement] Audio thread not found; its policy is up to SDL" << std::endl;
+}
+
+// On the side that runs the core, once the game is loaded.
+void place_emulation_thread(const std::vector<std::pair<const void *, size_t>> &buffers)
+{
+    if (!g_realtime)
+        return;
+    measure_sleep_jitter("before");
+    pin_current_thread();
+    lock_memory(buffers);
+    measure_sleep_jitter("after");
+}
+
+// --- Netplay ---
+// Two-player rollback netplay over UDP. Every frame each side sends its pad state,
+// scheduled NET delay frames ahead, and runs on a prediction of the peer's (its last
+// confirmed input). When the real input arrives and differs, the state saved before
+// the mispredicted frame is restored and the frames since are run again without
+// audio or video. Packets resend every unacknowledged input, so loss costs latency
+// but never stalls the protocol. Periodic checksums of confirmed states detect desyncs.
+
+constexpr uint32_t NET_MAGIC = 0x44504e31;  // "DPN1"
+constexpr uint32_t NET_HISTORY = 64;        // Frames of inputs and states kept
+constexpr uint32_t NET_MAX_ROLLBACK = 12;   // Run at most this far past the peer's confirmed input
+constexpr uint32_t NET_INPUT_WINDOW = 32;   // Most inputs carried by one packet
+constexpr uint32_t NET_CHECKSUM_INTERVAL = 60;
+constexpr uint32_t NET_NO_FRAME = UINT32_MAX;
+constexpr uint64_t NET_HANDSHAKE_TIMEOUT_NS = 30000000000ull;
+constexpr uint64_t NET_PEER_TIMEOUT_NS = 5000000000ull;
+constexpr uint64_t NET_HELLO_INTERVAL_NS = 100000000ull;
+
+enum NetPacketType : uint8_t
+{
+    NET_HELLO,
+    NET_INPUT,
+    NET_BYE,
+};
+
+// Wire format; multi-byte fields are little-endian
+struct NetPacket
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t count; // Inputs carried
+    uint16_t reserved;
+    uint32_t rom_crc;        // Both sides must run the same game
+    uint32_t first_frame;    // Frame of inputs[0]
+    uint32_t ack_frame;      // Sender holds every peer input before this frame
+    uint32_t checksum_frame; // Latest checksummed confirmed frame, or NET_NO_FRAME
+    uint32_t checksum;
+    uint16_t inputs[NET_INPUT_WINDOW]; // RETRO_DEVICE_ID_JOYPAD bit masks
+};
+
+struct NetFrame
+{
+    uint32_t number = NET_NO_FRAME;
+    uint16_t input[2] = {0, 0}; // Per port
+    bool remote_confirmed = false;
+    std::vector<uint8_t> state; // Serialized before the frame ran
+};
+
+struct Netplay
+{
+    bool active = false;
+    bool resimulating = false; // Audio and video are dropped while set
+    int fd = -1;
+    struct sockaddr_in peer = {};
+    unsigned local_port = 0; // Port the local pad drives; the peer has the other one
+    uint32_t frame = 0;      // Next frame to run
+    uint32_t remote_upto = 0; // Peer inputs confirmed for every frame before this
+    uint32_t peer_ack = 0;    // Peer holds our inputs for every frame before this
+    uint32_t rollback_from = NET_NO_FRAME;
+    uint16_t last_remote = 0;
+    uint16_t current[2] = {0, 0}; // What input_state reports during retro_run
+    uint64_t last_heard_ns = 0;
+    NetFrame frames[NET_HISTORY];
+
+    uint32_t next_checksum_frame = 0;
+    uint32_t sent_checksum_frame = NET_NO_FRAME;
+    uint32_t sent_checksum = 0;
+    std::map<uint32_t, uint32_t> local_checksums;
+    std::map<uint32_t, uint32_t> remote_checksums;
+
+    // Loopback testing: outgoing packets are delayed and dropped
+    std::deque<std::pair<uint64_t, std::vector<uint8_t>>> outbox;
+    uint32_t rng = 0x9e3779b9;
+
+    uint64_t frames_run = 0, stalls = 0, rollbacks = 0, resim_frames = 0, resim_ns = 0, resim_worst_ns = 0;
+    uint64_t sent = 0, dropped = 0, received = 0, desyncs = 0;
+};
+
+Netplay g_net;
+unsigned g_net_host_port = 0;   // --netplay-host
+std::string g_net_join;         // --netplay-join <host:port>
+unsigned g_net_delay = 1;       // --netplay-delay, frames of input delay
+unsigned g_net_latency_ms = 0;  // --netplay-latency, simulated one-way latency
+unsigned g_net_loss_percent = 0; // --netplay-loss, simulated packet loss
+
+static NetFrame &net_slot(uint32_t frame)
+{
+    NetFrame &slot = g_net.frames[frame % NET_HISTORY];
+    if (slot.number != frame)
+    {
+        slot.number = frame;
+        slot.input[0] = slot.input[1] = 0;
+        slot.remote_confirmed = false;
+    }
+    return slot;
+}
+
+static uint16_t local_joypad_mask()
+{
+    uint16_t mask = 0;
+    for (unsigned id = 0; id < 16; ++id)
+    {
+        if (g_joystick ? g_joy_state[id] : g_keyboard_state[id])
+            mask |= 1u << id;
+    }
+    return mask;
+}
+
+static void net_transmit(const void *data, size_t size)
+{
+    g_net.sent++;
+    g_net.rng = g_net.rng * 1664525u + 1013904223u;
+    if ((g_net.rng >> 8) % 100 < g_net_loss_percent)
+    {
+        g_net.dropped++;
+        return;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    g_net.outbox.emplace_back(now_ns() + g_net_latency_ms * 1000000ull, std::vector<uint8_t>(bytes, bytes + size));
+}
+
+static void net_flush_outbox()
+{
+    uint64_t now = now_ns();
+    while (!g_net.outbox.empty() && g_net.outbox.front().first <= now)
+    {
+        const auto &packet = g_net.outbox.front().second;
+        sendto(g_net.fd, packet.data(), packet.size(), 0, reinterpret_cast<const struct sockaddr *>(&g_net.peer),
+               sizeof(g_net.peer));
+        g_net.outbox.pop_front();
+    }
+}
+
+static NetPacket net_header(NetPacketType type)
+{
+    NetPacket packet = {};
+    packet.magic = htole32(NET_MAGIC);
+    packet.type = type;
+    packet.rom_crc = htole32(g_rom_crc);
+    packet.ack_frame = htole32(g_net.remote_upto);
+    packet.checksum_frame = htole32(g_net.sent_checksum_frame);
+    packet.checksum = htole32(g_net.sent_checksum);
+    return packet;
+}
+
+// Sends every local input the peer hasn't acknowledged, oldest first.
+static void net_send_inputs()
+{
+    NetPacket packet = net_header(NET_INPUT);
+    uint32_t known = g_net.frame + g_net_delay; // Local inputs exist for frames before this
+    uint32_t first = std::max(g_net.peer_ack, known > NET_HISTORY ? known - NET_HISTORY : 0);
+    uint32_t count = std::min(known - std::min(known, first), NET_INPUT_WINDOW);
+    packet.first_frame = htole32(first);
+    packet.count = count;
+    for (uint32_t i = 0; i < count; ++i)
+        packet.inputs[i] = htole16(net_slot(first + i).input[g_net.local_port]);
+    net_transmit(&packet, offsetof(NetPacket, inputs) + count * sizeof(uint16_t));
+    net_flush_outbox();
+}
+
+static void net_compare_checksum(uint32_t frame)
+{
+    auto local = g_net.local_checksums.find(frame);
+    auto remote = g_net.remote_checksums.find(frame);
+    if (local == g_net.local_checksums.end() || remote == g_net.remote_checksums.end())
+        return;
+    if (local->second != remote->second)
+    {
+        g_net.desyncs++;
+        std::cerr << "[netplay] Desync at frame " << frame << ": state checksum " << std::hex << local->second
+                  << " here, " << remote->second << " on the peer" << std::dec << std::endl;
+    }
+    g_net.local_checksums.erase(g_net.local_checksums.begin(), ++local);
+    g_net.remote_checksums.erase(g_net.remote_checksums.begin(), ++remote);
+}
+
+// Drains the socket. Returns false once the peer has left.
+static bool net_receive()
+{
+    NetPacket packet;
+    struct sockaddr_in from = {};
+    socklen_t from_size = sizeof(from);
+    ssize_t size;
+    while ((size = recvfrom(g_net.fd, &packet, sizeof(packet), 0, reinterpret_cast<struct sockaddr *>(&from),
+                            &from_size)) > 0)
+    {
+        if (size < ssize_t(offsetof(NetPacket, inputs)) || le32toh(packet.magic) != NET_MAGIC)
+            continue;
+        if (le32toh(packet.rom_crc) != g_rom_crc)
+            throw std::runtime_error("Netplay peer is running a different game");
+        g_net.received++;
+        g_net.last_heard_ns = now_ns();
+
+        if (packet.type == NET_BYE)
+            return false;
+        if (packet.type == NET_HELLO)
+        {
+            if (g_net.local_port == 0)
+            {
+                // The host learns (or relearns) the peer's address from its hello
+                g_net.peer = from;
+                NetPacket reply = net_header(NET_HELLO);
+                net_transmit(&reply, offsetof(NetPacket, inputs));
+            }
+            continue;
+        }
+
+        g_net.peer_ack = std::max(g_net.peer_ack, le32toh(packet.ack_frame));
+        uint32_t first = le32toh(packet.first_frame);
+        unsigned count = std::min<size_t>(packet.count, (size - offsetof(NetPacket, inputs)) / sizeof(uint16_t));
+        unsigned remote = 1 - g_net.local_port;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            uint32_t frame = first + i;
+            if (frame < g_net.remote_upto)
+                continue; // Resent, already have it
+            if (frame > g_net.remote_upto || frame >= g_net.frame + NET_HISTORY / 2)
+                break;
+            uint16_t input = le16toh(packet.inputs[i]);
+            NetFrame &slot = net_slot(frame);
+            if (frame < g_net.frame && slot.input[remote] != input)
+                g_net.rollback_from = std::min(g_net.rollback_from, frame);
+            slot.input[remote] = input;
+            slot.remote_confirmed = true;
+            g_net.last_remote = input;
+            g_net.remote_upto++;
+        }
+
+        uint32_t checksum_frame = le32toh(packet.checksum_frame);
+        if (checksum_frame != NET_NO_FRAME)
+        {
+            g_net.remote_checksums[checksum_frame] = le32toh(packet.checksum);
+            net_compare_checksum(checksum_frame);
+        }
+    }
+    net_flush_outbox();
+    return true;
+}
+
+// Saves the state, fills in the predicted remote input and runs one frame.
+static void net_run_frame(uint32_t frame)
+{
+    NetFrame &slot = net_slot(frame);
+    size_t size = core_retro_serialize_size();
+    memory_resize(MEM_SERIALIZE, slot.state, size);
+    core_retro_serialize(slot.state.data(), size);
+    if (!slot.remote_confirmed)
+        slot.input[1 - g_net.local_port] = g_net.last_remote;
+    g_net.current[0] = slot.input[0];
+    g_net.current[1] = slot.input[1];
+    run_core_frame(true);
+}
+
+// Checksums saved states once every input before them is confirmed.
+static void net_checksum_confirmed()
+{
+    while (g_net.next_checksum_frame <= g_net.remote_upto && g_net.next_checksum_frame < g_net.frame)
+    {
+        uint32_t frame = g_net.next_checksum_frame;
+        const NetFrame &slot = g_net.frames[frame % NET_HISTORY];
+        if (slot.number == frame)
+        {
+            uint32_t checksum = crc32(0, slot.state.data(), slot.state.size());
+            g_net.local_checksums[frame] = checksum;
+            g_net.sent_checksum_frame = frame;
+            g_net.sent_checksum = checksum;
+            net_compare_checksum(frame);
+        }
+        g_net.next_checksum_frame += NET_CHECKSUM_INTERVAL;
+    }
+}
+
+static void stop_netplay(const char *reason)
+{
+    std::cout << "[netplay] " << reason << std::endl;
+    NetPacket bye = net_header(NET_BYE);
+    sendto(g_net.fd, &bye, offsetof(NetPacket, inputs), 0, reinterpret_cast<const struct sockaddr *>(&g_net.peer),
+           sizeof(g_net.peer));
+    close(g_net.fd);
+    g_net.fd = -1;
+    g_net.active = false;
+}
+
+// Replaces retro_run while netplay is active. Runs one new frame, after any rollback
+// the latest peer inputs call for, or none if too far ahead of the peer. Returns
+// false when it stalled without running one.
+bool netplay_run_frame()
+{
+    if (!net_receive())
+    {
+        stop_netplay("Peer left; continuing offline");
+        run_core_frame(false);
+        return true;
+    }
+    if (now_ns() - g_net.last_heard_ns > NET_PEER_TIMEOUT_NS)
+    {
+        stop_netplay("Peer timed out; continuing offline");
+        run_core_frame(false);
+        return true;
+    }
+
+    if (g_net.rollback_from < g_net.frame)
+    {
+        uint64_t start = now_ns();
+        uint32_t from = g_net.rollback_from;
+        const NetFrame &slot = g_net.frames[from % NET_HISTORY];
+        core_retro_unserialize(slot.state.data(), slot.state.size());
+        g_net.resimulating = true;
+        for (uint32_t frame = from; frame < g_net.frame; ++frame)
+            net_run_frame(frame);
+        g_net.resimulating = false;
+        uint64_t elapsed = now_ns() - start;
+        g_net.rollbacks++;
+        g_net.resim_frames += g_net.frame - from;
+        g_net.resim_ns += elapsed;
+        g_net.resim_worst_ns = std::max(g_net.resim_worst_ns, elapsed);
+    }
+    g_net.rollback_from = NET_NO_FRAME;
+    net_checksum_confirmed();
+
+    if (g_net.frame >= g_net.remote_upto + NET_MAX_ROLLBACK)
+    {
+        // Too far ahead to roll back safely: wait for the peer, keep our inputs flowing
+        g_net.stalls++;
+        net_send_inputs();
+        return false;
+    }
+
+    net_slot(g_net.frame + g_net_delay).input[g_net.local_port] = local_joypad_mask();
+    net_send_inputs();
+    net_run_frame(g_net.frame);
+    g_net.frame++;
+    g_net.frames_run++;
+    return true;
+}
+
+// Binds the socket and waits for the peer. Both sides then start from frame 0.
+void start_netplay()
+{
+    if (g_net_host_port == 0 && g_net_join.empty())
+        return;
+    if (!core_retro_serialize_size || core_retro_serialize_size() == 0)
+        throw std::runtime_error("Netplay needs a core that supports save states");
+
+    g_net.fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (g_net.fd < 0)
+        throw std::runtime_error("Netplay socket: " + std::string(strerror(errno)));
+    struct sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(g_net_host_port);
+    if (bind(g_net.fd, reinterpret_cast<struct sockaddr *>(&local), sizeof(local)) != 0)
+        throw std::runtime_error("Netplay bind to port " + std::to_string(g_net_host_port) + ": " + strerror(errno));
+
+    bool joining = !g_net_join.empty();
+    g_net.local_port = joining ? 1 : 0;
+    if (joining)
+    {
+        size_t colon = g_net_join.rfind(':');
+        std::string host = g_net_join.substr(0, colon);
+        std::string service = colon == std::string::npos ? "" : g_net_join.substr(colon + 1);
+        struct addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        struct addrinfo *result = nullptr;
+        if (service.empty() || getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0)
+            throw std::runtime_error("Netplay can't resolve " + g_net_join + " (expected host:port)");
+        std::memcpy(&g_net.peer, result->ai_addr, sizeof(g_net.peer));
+        freeaddrinfo(result);
+        std::cout << "[netplay] Joining " << g_net_join << " as player 2" << std::endl;
+    }
+    else
+    {
+        std::cout << "[netplay] Hosting on UDP port " << g_net_host_port << " as player 1, waiting for a peer"
+                  << std::endl;
+    }
+    if (g_net_latency_ms || g_net_loss_percent)
+        std::cout << "[netplay] Simulating " << g_net_latency_ms << " ms latency and " << g_net_loss_percent
+                  << "% loss" << std::endl;
+
+    // The joiner says hello until the host answers; the host answers every hello
+    uint64_t start = now_ns();
+    uint64_t last_hello = 0;
+    while (g_net.last_heard_ns == 0)
+    {
+        if (g_terminate || now_ns() - start > NET_HANDSHAKE_TIMEOUT_NS)
+            throw std::runtime_error("Netplay peer didn't answer");
+        if (joining && now_ns() - last_hello > NET_HELLO_INTERVAL_NS)
+        {
+            NetPacket hello = net_header(NET_HELLO);
+            net_transmit(&hello, offsetof(NetPacket, inputs));
+            last_hello = now_ns();
+        }
+        net_receive();
+        usleep(1000);
+    }
+
+    // Inputs inside the delay window are neutral on both sides
+    for (uint32_t frame = 0; frame < g_net_delay; ++frame)
+        net_slot(frame);
+    g_net.active = true;
+    std::cout << "[netplay] Connected in " << (now_ns() - start) / 1000000 << " ms, " << g_net_delay
+              << " frame input delay, rollback up to " << NET_MAX_ROLLBACK << " frames" << std::endl;
+}
+
+void report_netplay_stats()
+{
+    if (g_net.frames_run == 0)
+        return;
+    if (g_net.active)
+        stop_netplay("Session ended");
+    std::cout << "[netplay] " << g_net.frames_run << " frames, " << g_net.stalls << " stalls, " << g_net.rollbacks
+              << " rollbacks resimulating " << g_net.resim_frames << " frames; resimulation "
+              << g_net.resim_ns / 1000.0 / g_net.frames_run << " us per frame avg, "
+              << g_net.resim_worst_ns / 1000.0 << " us worst; " << g_net.sent << " packets sent ("
+              << g_net.dropped << " dropped), " << g_net.received << " received, " << g_net.desyncs << " desyncs"
+              << std::endl;
+}
+
+// --- Libretro Callback Implementations ---
+
+bool callback_environment(unsigned cmd, void *data)
+{
+    switch (cmd)
+    {
+    case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+    {
+        // Route core logs to the asynchronous logger instead of letting the core
+        // fall back to synchronous stdio from inside retro_run
+        start_core_logger();
+        ((struct retro_log_callback *)data)->log = callback_log;
+        break;
+    }
+    case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+    {
+        *(bool *)data = true;
+        break;
+    }
+    case RETRO_ENVIRONMENT_GET_VARIABLE:
+    {
+        auto *var = (struct retro_variable *)data;
+        OptionSlot *slot = var->key ? option_find(var->key) : nullptr;
+        var->value = slot ? slot->value : nullptr;
+        return slot != nullptr;
+    }
+    case RETRO_ENVIRONMENT_SET_VARIABLES:
+    {
+        define_legacy_options((const struct retro_variable *)data);
+        break;
+    }
+    case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+    {
+        *(bool *)data = g_options_updated;
+        g_options_updated = false;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_VARIABLE:
+    {
+        auto *var = (const struct retro_variable *)data;
+        if (!var)
+            return true; // The core is only asking whether this is supported
+        OptionSlot *slot = var->key ? option_find(var->key) : nullptr;
+        if (!slot || !var->value)
+            return false;
+        g_options_updated |= option_set(*slot, var->value, "core");
+        break;
+    }
+    case RETRO_ENVIRONMENT_GET_CORE_OPTIONS_VERSION:
+    {
+        *(unsigned *)data = 2;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS:
+    {
+        define_options((const struct retro_core_option_definition *)data);
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_INTL:
+    {
+        define_options(((const struct retro_core_options_intl *)data)->us);
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_V2:
+    {
+        auto *options = (const struct retro_core_options_v2 *)data;
+        define_options(options ? options->definitions : nullptr);
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_V2_INTL:
+    {
+        auto *intl = (const struct retro_core_options_v2_intl *)data;
+        define_options(intl && intl->us ? intl->us->definitions : nullptr);
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY:
+    {
+        // We have no options menu, so visibility doesn't matter
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_GEOMETRY:
+    {
+        // Base size and aspect only; the texture already covers max_width/max_height
+        const auto *geometry = (const struct retro_game_geometry *)data;
+        g_av_info.geometry.base_width = geometry->base_width;
+        g_av_info.geometry.base_height = geometry->base_height;
+        g_av_info.geometry.aspect_ratio = geometry->aspect_ratio;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO:
+    {
+        // The presenter picks up the new geometry on the next frame. The audio device
+        // keeps its rate; SDL's queue doesn't resample.
+        g_av_info = *(const struct retro_system_av_info *)data;
+        break;
+    }
+    case RETRO_ENVIRONMENT_GET_DISK_CONTROL_INTERFACE_VERSION:
+    {
+        *(unsigned *)data = 1;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_DISK_CONTROL_INTERFACE:
+    {
+        // The legacy interface is a prefix of the extended one
+        const auto *cb = (const struct retro_disk_control_callback *)data;
+        g_disk_control = {};
+        g_disk_control.set_eject_state = cb->set_eject_state;
+        g_disk_control.get_eject_state = cb->get_eject_state;
+        g_disk_control.get_image_index = cb->get_image_index;
+        g_disk_control.set_image_index = cb->set_image_index;
+        g_disk_control.get_num_images = cb->get_num_images;
+        g_disk_control.replace_image_index = cb->replace_image_index;
+        g_disk_control.add_image_index = cb->add_image_index;
+        g_has_disk_control = true;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_DISK_CONTROL_EXT_INTERFACE:
+    {
+        g_disk_control = *(const struct retro_disk_control_ext_callback *)data;
+        g_has_disk_control = true;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK:
+    {
+        g_frame_time = *(const struct retro_frame_time_callback *)data;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_AUDIO_CALLBACK:
+    {
+        // The sandbox host has no audio thread to drive it; the core falls back to batches
+        if (g_sandbox)
+            return false;
+        g_audio_callback = *(const struct retro_audio_callback *)data;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_MEMORY_MAPS:
+    {
+        if (!set_memory_maps((const struct retro_memory_map *)data))
+        {
+            std::cerr << "[watch] Ignoring a memory map the specification can't resolve" << std::endl;
+            return false;
+        }
+        break;
+    }
+    case RETRO_ENVIRONMENT_GET_VFS_INTERFACE:
+    {
+        auto *info = (struct retro_vfs_interface_info *)data;
+        if (info->required_interface_version > VFS_INTERFACE_VERSION)
+            return false;
+        info->required_interface_version = VFS_INTERFACE_VERSION;
+        info->iface = &g_vfs_interface;
+        break;
+    }
+    case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+    {
+        // Remember the format so the video path (and the sandbox host) can forward it.
+        // The core will ideally choose RGB565 or XRGB8888.
+        g_pixel_format = *(enum retro_pixel_format *)data;
+        return true; // Return true to indicate we handled this
+    }
+    default:
+        // Log that we received an unhandled command
+        return false;
+    }
+    return true;
+}
+
+void callback_video_refresh(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+    // This callback is called once per frame from retro_run().
+    // If 'data' is RETRO_HW_FRAME_BUFFER_VALID, the core has rendered directly to our
+    // bound OpenGL context. We just need to swap the window buffers.
+    // Software frames are uploaded to the presenter's texture; NULL means the core
+    // duped the previous frame, which is still in the texture.
+    if (g_net.resimulating)
+    {
+        return; // Rollback frames were already shown once
+    }
+    if (data == RETRO_HW_FRAME_BUFFER_VALID)
+    {
+        // Core rendered to hardware, nothing to do here.
+    }
+    else if (data)
+    {
+        upload_frame(data, width, height, pitch);
+        sample_thumbnail(data, width, height, pitch);
+    }
+    if (data != RETRO_HW_FRAME_BUFFER_VALID)
+    {
+        capture_frame(data, width, height, pitch);
+    }
+}
+
+void callback_audio_sample(int16_t left, int16_t right)
+{
+    int16_t buf[2] = {left, right};
+    if (g_audio_pulling)
+    {
+        // SDL's thread asked for it; the flags below belong to the emulation thread
+        audio_pull_append(buf, 1);
+        return;
+    }
+    if (g_net.resimulating || g_unthrottled)
+        return;
+    if (g_audio_callback.callback)
+    {
+        audio_pull_append(buf, 1);
+        return;
+    }
+    SDL_QueueAudio(g_audio_device, buf, sizeof(buf));
+    capture_audio(buf, 1);
+}
+
+size_t callback_audio_sample_batch(const int16_t *data, size_t frames)
+{
+    if (g_audio_pulling)
+    {
+        audio_pull_append(data, frames);
+        return frames;
+    }
+    if (g_net.resimulating || g_unthrottled)
+        return frames;
+    if (g_audio_callback.callback)
+    {
+        // Not captured: the capture staging buffer belongs to the emulation thread
+        audio_pull_append(data, frames);
+        return frames;
+    }
+    SDL_QueueAudio(g_audio_device, data, frames * 2 * sizeof(int16_t));
+    capture_audio(data, frames);
+    return frames; // Return the number of frames consumed
+}
+
+void callback_input_poll(void)
+{
+    // Clear previous state
+    for (int i = 0; i < 16; ++i)
+    {
+        g_keyboard_state[i] = 0;
+        g_joy_state[i] = 0;
+    }
+
+    if (g_terminate)
+    {
+        g_running = false;
+    }
+
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE))
+        {
+            g_running = false;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F2 && !event.key.repeat)
+        {
+            g_disc_swap_requests++;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9 && !event.key.repeat)
+        {
+            g_memory_report_requests++;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12 && !event.key.repeat)
+        {
+            g_screenshot_requests++;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F10 && !event.key.repeat)
+        {
+            if (g_record)
+                g_record_dump_requests++;
+            else
+                std::cout << "[capture] Start with --record to keep the last " << RECORD_SECONDS << " seconds" << std::endl;
+        }
+    }
+
+    // --- Keyboard Input ---
+    const Uint8 *keys = SDL_GetKeyboardState(NULL);
+    if (keys[SDL_SCANCODE_UP])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_UP] = 1;
+    if (keys[SDL_SCANCODE_DOWN])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_DOWN] = 1;
+    if (keys[SDL_SCANCODE_LEFT])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_LEFT] = 1;
+    if (keys[SDL_SCANCODE_RIGHT])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_RIGHT] = 1;
+    if (keys[SDL_SCANCODE_Z])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_A] = 1; // "A" button
+    if (keys[SDL_SCANCODE_X])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_B] = 1; // "B" button
+    if (keys[SDL_SCANCODE_A])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_X] = 1; // "X" button
+    if (keys[SDL_SCANCODE_S])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_Y] = 1; // "Y" button
+    if (keys[SDL_SCANCODE_RETURN])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_START] = 1;
+    if (keys[SDL_SCANCODE_RSHIFT])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_SELECT] = 1;
+    if (keys[SDL_SCANCODE_Q])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_L] = 1;
+    if (keys[SDL_SCANCODE_W])
+        g_keyboard_state[RETRO_DEVICE_ID_JOYPAD_R] = 1;
+    g_fast_forward = keys[SDL_SCANCODE_TAB]; // Held, not toggled
+
+    // --- Joystick Input ---
+    if (g_joystick)
+    {
+        SDL_JoystickUpdate();
+        // This mapping is a guess for a typical Gamecube-style controller.
+        // It may need adjustment for your specific controller.
+        if (SDL_JoystickGetButton(g_joystick, 0))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_A] = 1; // A button
+        if (SDL_JoystickGetButton(g_joystick, 1))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_B] = 1; // B button
+        if (SDL_JoystickGetButton(g_joystick, 2))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_X] = 1; // X button
+        if (SDL_JoystickGetButton(g_joystick, 3))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_Y] = 1; // Y button
+        if (SDL_JoystickGetButton(g_joystick, 4))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_L] = 1; // L shoulder
+        if (SDL_JoystickGetButton(g_joystick, 5))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_R] = 1; // R shoulder
+        if (SDL_JoystickGetButton(g_joystick, 9))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_START] = 1; // Start button
+        // Select button is often missing on GC controllers, map to Z trigger?
+        if (SDL_JoystickGetButton(g_joystick, 6))
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_SELECT] = 1; // Z trigger
+
+        // D-Pad (often handled as a hat)
+        Uint8 hat = SDL_JoystickGetHat(g_joystick, 0);
+        if (hat & SDL_HAT_UP)
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_UP] = 1;
+        if (hat & SDL_HAT_DOWN)
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_DOWN] = 1;
+        if (hat & SDL_HAT_LEFT)
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_LEFT] = 1;
+        if (hat & SDL_HAT_RIGHT)
+            g_joy_state[RETRO_DEVICE_ID_JOYPAD_RIGHT] = 1;
+
+        // Select+R swaps discs
+        static bool swap_held = false;
+        bool swap = g_joy_state[RETRO_DEVICE_ID_JOYPAD_SELECT] && g_joy_state[RETRO_DEVICE_ID_JOYPAD_R];
+        if (swap && !swap_held)
+            g_disc_swap_requests++;
+        swap_held = swap;
+    }
+}
+
+int16_t callback_input_state(unsigned port, unsigned /*device*/, unsigned /*index*/, unsigned id)
+{
+    if (g_net.active)
+    {
+        // Both pads come from the netplay input for the frame being run
+        return port < 2 && id < 16 ? (g_net.current[port] >> id) & 1 : 0;
+    }
+    if (port == 0 && id < 16)
+    {
+        // If joystick is active, it takes priority. Otherwise, use keyboard.
+        if (g_joystick)
+        {
+            return g_joy_state[id];
+        }
+        return g_keyboard_state[id];
+    }
+    return 0; // Only support one player
+}
+
+// --- Helper Functions ---
+
+// Startup steps run on several threads; each logs its duration and when it finished
+// relative to process start so overlapping steps are visible in the output.
+std::mutex g_startup_trace_mutex;
+
+void trace_startup(const char *step, uint64_t start_ns)
+{
+    uint64_t end = now_ns();
+    std::lock_guard<std::mutex> lock(g_startup_trace_mutex);
+    std::cout << "[startup] " << step << ": " << (end - start_ns) / 1e6 << " ms (done at +"
+              << (end - g_startup_ns) / 1e6 << " ms)" << std::endl;
+}
+
+// Writes the whole buffer, retrying on short writes. Returns false on error.
+static bool write_all(int fd, const void *data, size_t size)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void handle_terminate_signal(int /*sig*/)
+{
+    g_terminate = 1;
+}
+
+#define LOAD_SYM(V, S)                                              \
+    do                                                              \
+    {                                                               \
+        V = (decltype(V))dlsym(g_core_handle, #S);                  \
+        if (!V)                                                     \
+            throw std::runtime_error("Failed to load symbol: " #S); \
+    } while (0)
+
+void load_core(const std::string &core_path)
+{
+    uint64_t start = now_ns();
+    g_core_handle = dlopen(core_path.c_str(), RTLD_LAZY);
+    if (!g_core_handle)
+    {
+        throw std::runtime_error("Failed to load core: " + core_path + " - " + dlerror());
+    }
+
+    // Load all the required libretro functions from the .so file
+    LOAD_SYM(core_retro_init, retro_init);
+    LOAD_SYM(core_retro_deinit, retro_deinit);
+    LOAD_SYM(core_retro_api_version, retro_api_version);
+    LOAD_SYM(core_retro_get_system_info, retro_get_system_info);
+    LOAD_SYM(core_retro_get_system_av_info, retro_get_system_av_info);
+    LOAD_SYM(core_retro_set_controller_port_device, retro_set_controller_port_device);
+    LOAD_SYM(core_retro_reset, retro_reset);
+    LOAD_SYM(core_retro_run, retro_run);
+    LOAD_SYM(core_retro_serialize_size, retro_serialize_size);
+    LOAD_SYM(core_retro_serialize, retro_serialize);
+    LOAD_SYM(core_retro_unserialize, retro_unserialize);
+    LOAD_SYM(core_retro_load_game, retro_load_game);
+    LOAD_SYM(core_retro_unload_game, retro_unload_game);
+    LOAD_SYM(core_retro_get_memory_data, retro_get_memory_data);
+    LOAD_SYM(core_retro_get_memory_size, retro_get_memory_size);
+    LOAD_SYM(core_retro_set_video_refresh, retro_set_video_refresh);
+    LOAD_SYM(core_retro_set_audio_sample, retro_set_audio_sample);
+    LOAD_SYM(core_retro_set_audio_sample_batch, retro_set_audio_sample_batch);
+    LOAD_SYM(core_retro_set_input_poll, retro_set_input_poll);
+    LOAD_SYM(core_retro_set_input_state, retro_set_input_state);
+    LOAD_SYM(core_retro_set_environment, retro_set_environment);
+
+    // Set the callbacks
+    core_retro_set_environment(callback_environment);
+    core_retro_set_video_refresh(callback_video_refresh);
+    core_retro_set_audio_sample(callback_audio_sample);
+    core_retro_set_audio_sample_batch(callback_audio_sample_batch);
+    core_retro_set_input_poll(callback_input_poll);
+    core_retro_set_input_state(callback_input_state);
+    trace_startup("load_core", start);
+}
+
+void init_sdl_gl()
+{
+    uint64_t start = now_ns();
+
+    // We install our own SIGTERM/SIGINT handlers so a kill gets the same suspend as a window close
+    SDL_SetHint(SDL_HINT_NO_SIGNAL_HANDLERS, "1");
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK) != 0)
+    {
+        throw std::runtime_error("Failed to initialize SDL: " + std::string(SDL_GetError()));
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+
+    g_window = SDL_CreateWindow("Retro Launcher", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, SDL_WINDOW_OPENGL);
+    if (!g_window)
+    {
+        throw std::runtime_error("Failed to create SDL window: " + std::string(SDL_GetError()));
+    }
+
+    g_gl_context = SDL_GL_CreateContext(g_window);
+    if (!g_gl_context)
+    {
+        throw std::runtime_error("Failed to create OpenGL context: " + std::string(SDL_GetError()));
+    }
+    SDL_GL_MakeCurrent(g_window, g_gl_context);
+    SDL_GL_SetSwapInterval(1); // Enable VSync
+    init_presenter();
+
+    // Initialize Joystick
+    if (SDL_NumJoysticks() > 0)
+    {
+        g_joystick = SDL_JoystickOpen(0);
+        if (g_joystick)
+        {
+            std::cout << "Joystick detected: " << SDL_JoystickName(g_joystick) << std::endl;
+        }
+    }
+    else
+    {
+        std::cout << "No joystick detected. Using keyboard only." << std::endl;
+    }
+    trace_startup("init_sdl_gl", start);
+}
+
+void init_audio(double sample_rate)
+{
+    SDL_AudioSpec want, have;
+    SDL_zero(want);
+    want.freq = static_cast<int>(sample_rate);
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = g_audio_samples;
+    want.callback = NULL; // We will queue audio
+    if (g_audio_callback.callback)
+    {
+        want.callback = audio_pull_callback; // The core makes audio on demand
+    }
+
+    if (g_realtime)
+    {
+        // SDL raises its audio thread to TIME_CRITICAL; these make that SCHED_FIFO,
+        // through RTKit when we lack RLIMIT_RTPRIO
+        SDL_SetHint(SDL_HINT_THREAD_PRIORITY_POLICY, "fifo");
+        SDL_SetHint(SDL_HINT_THREAD_FORCE_REALTIME_TIME_CRITICAL, "1");
+    }
+    g_audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (g_audio_device == 0)
+    {
+        throw std::runtime_error("Failed to open audio device: " + std::string(SDL_GetError()));
+    }
+    static int64_t device_bytes = 0; // Reopened when an audio callback core loads
+    memory_track(MEM_AUDIO, int64_t(have.samples) * have.channels * sizeof(int16_t) - device_bytes);
+    device_bytes = int64_t(have.samples) * have.channels * sizeof(int16_t);
+    if (g_audio_callback.callback)
+    {
+        // Never reallocated on the audio thread: appends stop at AUDIO_PULL_MAX_SAMPLES
+        size_t capacity = g_audio_pull.capacity();
+        g_audio_pull.reserve(AUDIO_PULL_MAX_SAMPLES);
+        memory_track(MEM_AUDIO, int64_t((g_audio_pull.capacity() - capacity) * sizeof(int16_t)));
+    }
+    SDL_PauseAudioDevice(g_audio_device, 0); // Start playing
+    if (g_realtime)
+        report_audio_thread_policy();
+}
+
+constexpr off_t ROM_IN_MEMORY_MAX = 64 * 1024 * 1024;
+constexpr size_t ROM_HASH_PREFIX = 1024 * 1024;
+
+// Reads the whole ROM into memory. Runs on a worker thread during startup so slow
+// storage overlaps with window and GL context creation.
+std::vector<uint8_t> read_rom(const std::string &rom_path)
+{
+    uint64_t start = now_ns();
+    int fd = open(rom_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open ROM file: " + rom_path);
+    }
+
+    struct stat st = {};
+    std::vector<uint8_t> data;
+    if (fstat(fd, &st) == 0 && st.st_size > ROM_IN_MEMORY_MAX)
+    {
+        // Disc images are left for the core to stream by path; identify them by their head
+        data.resize(ROM_HASH_PREFIX);
+        ssize_t n = pread(fd, data.data(), data.size(), 0);
+        g_rom_crc = crc32(0, data.data(), n > 0 ? n : 0);
+        close(fd);
+        trace_startup("read_rom", start);
+        return {};
+    }
+    if (st.st_size > 0)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        data.resize(st.st_size);
+
+        size_t done = 0;
+        while (done < data.size())
+        {
+            ssize_t n = read(fd, data.data() + done, data.size() - done);
+            if (n <= 0)
+            {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                break;
+            }
+            done += n;
+        }
+        data.resize(done);
+        memory_track(MEM_ROM, data.capacity());
+    }
+    close(fd);
+    g_rom_crc = crc32(0, data.data(), data.size());
+
+    trace_startup("read_rom", start);
+    return data;
+}
+
+bool load_rom(const std::string &rom_path)
+{
+    // The core will handle loading from the path, but some cores require the data
+    // to be loaded into memory first. We will do both.
+    uint64_t start = now_ns();
+    std::string content_path = resolve_content_path(rom_path);
+    struct retro_game_info game_info = {};
+    game_info.path = content_path.c_str();
+    if (!g_rom_data.empty() && content_path == rom_path)
+    {
+        game_info.data = g_rom_data.data();
+        game_info.size = g_rom_data.size();
+    }
+
+    if (!core_retro_load_game(&game_info))
+    {
+        std::cerr << "The core failed to load the game." << std::endl;
+        return false;
+    }
+    trace_startup("retro_load_game", start);
+    start_disk_control();
+    start_ram_watch();
+    return true;
+}
+
+void cleanup()
+{
+    report_memory("frontend at exit");
+    report_netplay_stats();
+    report_benchmark();
+    stop_audio_callback();
+    stop_capture();
+    save_perf_profile();
+    report_present_stats();
+    stop_disc_prefetch();
+    if (core_retro_unload_game)
+        core_retro_unload_game();
+    if (core_retro_deinit)
+        core_retro_deinit();
+    stop_core_logger();
+    report_vfs_stats();
+    report_watch_stats();
+    if (g_core_handle)
+        dlclose(g_core_handle);
+
+    if (g_joystick)
+        SDL_JoystickClose(g_joystick);
+    if (g_audio_device > 0)
+        SDL_CloseAudioDevice(g_audio_device);
+    if (g_gl_context)
+        SDL_GL_DeleteContext(g_gl_context);
+    if (g_window)
+        SDL_DestroyWindow(g_window);
+    SDL_Quit();
+}
+
+// --- Fast Resume ---
+// On exit the running game is written to a per-ROM resume file (thumbnail plus a
+// deflated save state) and restored on the next launch before the first frame.
+// Buffers are allocated once the game is loaded so the exit path only serializes,
+// compresses and writes, and compression is abandoned if it threatens the budget.
+
+constexpr int SUSPEND_BUDGET_MS = 250;          // Whole suspend, before the WM force-closes us
+constexpr int SUSPEND_COMPRESS_BUDGET_MS = 150; // Past this we store the state uncompressed
+constexpr size_t SUSPEND_CHUNK_BYTES = 256 * 1024;
+constexpr uint32_t RESUME_COMPRESSED = 1;
+const char RESUME_MAGIC[8] = {'D', 'N', 'D', 'Y', 'R', 'S', 'M', '1'};
+
+struct ResumeHeader
+{
+    char magic[8];
+    uint32_t rom_crc;
+    uint32_t flags;
+    uint64_t rom_size;
+    uint64_t state_size;   // Uncompressed save state size
+    uint64_t payload_size; // Bytes stored after the thumbnail
+    uint64_t frame_count;  // Frames emulated when the state was taken
+    uint32_t thumb_width;  // RGB888 thumbnail follows the header
+    uint32_t thumb_height;
+};
+
+std::vector<uint8_t> g_state_buffer; // Raw retro_serialize output
+std::vector<uint8_t> g_state_packed; // Deflated state, sized with compressBound
+std::vector<uint8_t> g_thumb_buffer;
+std::string g_resume_path;
+
+// Picks the resume file for a ROM and allocates everything suspend_to_state needs.
+void prepare_resume(const std::string &rom_path)
+{
+    const char *home = getenv("HOME");
+    std::filesystem::path dir = std::filesystem::path(home ? home : "/tmp") / ".local/share/dendy/states";
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    g_resume_path = (dir / (std::filesystem::path(rom_path).filename().string() + ".resume")).string();
+
+    size_t size = core_retro_serialize_size();
+    memory_resize(MEM_SERIALIZE, g_state_buffer, size);
+    memory_resize(MEM_SERIALIZE, g_state_packed, compressBound(size));
+    memory_resize(MEM_SERIALIZE, g_thumb_buffer, RESUME_THUMB_MAX * RESUME_THUMB_MAX * 3);
+    memory_resize(MEM_SERIALIZE, g_thumb_pixels, RESUME_THUMB_MAX * RESUME_THUMB_MAX * 4);
+}
+
+// Converts the thumbnail sampled from the last frame to RGB888. Returns false if
+// no frame was seen.
+bool make_thumbnail(uint32_t &thumb_width, uint32_t &thumb_height)
+{
+    if (g_thumb_width == 0 || g_thumb_height == 0)
+        return false;
+
+    thumb_width = g_thumb_width;
+    thumb_height = g_thumb_height;
+    unsigned bpp = pixel_size(g_thumb_format);
+    size_t count = (size_t)thumb_width * thumb_height;
+    for (size_t i = 0; i < count; ++i)
+    {
+        pixel_to_rgb(&g_thumb_pixels[i * bpp], g_thumb_format, &g_thumb_buffer[i * 3]);
+    }
+    return true;
+}
+
+// Writes the resume file. Called on the way out, before the game is unloaded.
+void suspend_to_state()
+{
+    uint64_t start = now_ns();
+    if (g_resume_path.empty())
+        return;
+
+    size_t size = core_retro_serialize_size();
+    if (size == 0)
+    {
+        std::cout << "[suspend] Core does not support save states" << std::endl;
+        return;
+    }
+    if (size > g_state_buffer.size())
+    {
+        // The state grew since load; this allocation is outside the fast path
+        memory_resize(MEM_SERIALIZE, g_state_buffer, size);
+        memory_resize(MEM_SERIALIZE, g_state_packed, compressBound(size));
+    }
+    if (!core_retro_serialize(g_state_buffer.data(), size))
+    {
+        std::cerr << "[suspend] retro_serialize failed" << std::endl;
+        return;
+    }
+    uint64_t serialized = now_ns();
+
+    ResumeHeader header = {};
+    std::memcpy(header.magic, RESUME_MAGIC, sizeof(header.magic));
+    header.rom_crc = g_rom_crc;
+    header.rom_size = g_rom_data.size();
+    header.state_size = size;
+    header.frame_count = g_frame_count;
+    if (!make_thumbnail(header.thumb_width, header.thumb_height))
+    {
+        header.thumb_width = header.thumb_height = 0;
+    }
+
+    // Deflate in chunks so we can give up if the budget runs out
+    uint64_t compress_deadline = start + SUSPEND_COMPRESS_BUDGET_MS * 1000000ull;
+    z_stream zs = {};
+    bool compressed = deflateInit(&zs, Z_BEST_SPEED) == Z_OK;
+    if (compressed)
+    {
+        zs.next_out = g_state_packed.data();
+        zs.avail_out = g_state_packed.size();
+        size_t offset = 0;
+        int ret = Z_OK;
+        while (ret == Z_OK)
+        {
+            size_t chunk = std::min(SUSPEND_CHUNK_BYTES, size - offset);
+            zs.next_in = g_state_buffer.data() + offset;
+            zs.avail_in = chunk;
+            offset += chunk;
+            ret = deflate(&zs, offset == size ? Z_FINISH : Z_NO_FLUSH);
+            if (ret == Z_OK && offset == size)
+            {
+                ret = Z_BUF_ERROR; // Z_FINISH with compressBound space must end the stream
+            }
+            if (now_ns() > compress_deadline)
+            {
+                ret = Z_BUF_ERROR;
+            }
+        }
+        compressed = ret == Z_STREAM_END;
+        header.payload_size = zs.total_out;
+        deflateEnd(&zs);
+    }
+    const uint8_t *payload = compressed ? g_state_packed.data() : g_state_buffer.data();
+    if (compressed)
+    {
+        header.flags |= RESUME_COMPRESSED;
+    }
+    else
+    {
+        header.payload_size = size;
+    }
+    uint64_t packed = now_ns();
+
+    // Write beside the old file and rename so a kill mid-write never leaves a torn state
+    std::string tmp_path = g_resume_path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 &&
+              write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, g_thumb_buffer.data(), (size_t)header.thumb_width * header.thumb_height * 3) &&
+              write_all(fd, payload, header.payload_size);
+    if (fd >= 0)
+        close(fd);
+    if (!ok || rename(tmp_path.c_str(), g_resume_path.c_str()) != 0)
+    {
+        std::cerr << "[suspend] Failed to write " << g_resume_path << std::endl;
+        unlink(tmp_path.c_str());
+        return;
+    }
+
+    uint64_t end = now_ns();
+    std::cout << "[suspend] " << size / 1024 << " KB state -> " << header.payload_size / 1024 << " KB"
+              << (compressed ? "" : " (uncompressed, over budget)") << " in " << (end - start) / 1e6
+              << " ms (serialize " << (serialized - start) / 1e6 << ", compress " << (packed - serialized) / 1e6
+              << ", write " << (end - packed) / 1e6 << ")" << std::endl;
+    if (end - start > SUSPEND_BUDGET_MS * 1000000ull)
+    {
+        std::cerr << "[suspend] Exceeded the " << SUSPEND_BUDGET_MS << " ms budget" << std::endl;
+    }
+}
+
+// Restores the resume file for the loaded ROM, if there is a matching one.
+bool resume_from_state()
+{
+    uint64_t start = now_ns();
+    int fd = open(g_resume_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    ResumeHeader header;
+    bool ok = read(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+              std::memcmp(header.magic, RESUME_MAGIC, sizeof(header.magic)) == 0 &&
+              header.rom_crc == g_rom_crc && header.rom_size == g_rom_data.size() &&
+              header.state_size <= g_state_buffer.size();
+    if (ok)
+    {
+        bool compressed = header.flags & RESUME_COMPRESSED;
+        std::vector<uint8_t> &target = compressed ? g_state_packed : g_state_buffer;
+        off_t payload_offset = sizeof(header) + (off_t)header.thumb_width * header.thumb_height * 3;
+        ok = header.payload_size <= target.size() &&
+             pread(fd, target.data(), header.payload_size, payload_offset) == (ssize_t)header.payload_size;
+        if (ok && compressed)
+        {
+            uLongf out_size = header.state_size;
+            ok = uncompress(g_state_buffer.data(), &out_size, g_state_packed.data(), header.payload_size) == Z_OK &&
+                 out_size == header.state_size;
+        }
+    }
+    close(fd);
+
+    if (!ok || !core_retro_unserialize(g_state_buffer.data(), header.state_size))
+    {
+        std::cerr << "[resume] Ignoring stale or unreadable " << g_resume_path << std::endl;
+        return false;
+    }
+
+    g_frame_count = header.frame_count;
+    double fps = 60.0;
+    if (core_retro_get_system_av_info)
+    {
+        struct retro_system_av_info av_info;
+        core_retro_get_system_av_info(&av_info);
+        fps = av_info.timing.fps;
+    }
+    std::cout << "[resume] Restored " << header.state_size / 1024 << " KB state in " << (now_ns() - start) / 1e6
+              << " ms, skipping " << header.frame_count << " frames (" << header.frame_count / fps
+              << " s) of emulation" << std::endl;
+    return true;
+}
+
+// Called once the ROM is loaded, before the first frame.
+void start_resume(const std::string &rom_path)
+{
+    prepare_resume(rom_path);
+    if (g_resume)
+    {
+        resume_from_state();
+    }
+}
+
+// --- Sandboxed Core Host ---
+// In split-process mode the core is dlopen'd by a forked host process, while this
+// (UI) process keeps SDL, GL and audio. Both sides share one anonymous mapping:
+// the host copies each video frame into it once and appends audio to a ring, the
+// UI publishes input and requests frames. Frame hand-off is signalled with futexes,
+// so a core crash only takes down the host and the UI can report it and exit.
+
+constexpr size_t SANDBOX_VIDEO_BYTES = 2048 * 2048 * 4; // Largest frame we forward (XRGB8888)
+constexpr uint32_t SANDBOX_AUDIO_FRAMES = 16384;         // Stereo frames in the audio ring (power of two)
+constexpr int SANDBOX_POLL_MS = 50;                      // How often a blocked side checks its peer
+
+enum SandboxHostState : uint32_t
+{
+    HOST_STARTING,
+    HOST_READY,
+    HOST_FAILED
+};
+
+struct SandboxShared
+{
+    std::atomic<uint32_t> run_seq;    // Bumped by the UI to request a frame (futex word)
+    std::atomic<uint32_t> done_seq;   // Set to run_seq by the host when the frame is done (futex word)
+    std::atomic<uint32_t> host_state; // SandboxHostState (futex word)
+    std::atomic<uint32_t> quit;       // Set by the UI to stop the host
+    char error[256];                  // Reason for HOST_FAILED
+
+    struct retro_system_av_info av_info;
+    enum retro_pixel_format pixel_format;
+    int16_t input[16]; // Effective port 0 pad state, written before run_seq is bumped
+    uint32_t disc_swap_requests;
+    uint32_t rom_crc;
+    uint32_t fixed_frame_time; // Fast-forward or benchmark: frame-time cores get the reference delta
+
+    // Last frame; width == 0 means the core duped the previous frame
+    unsigned width;
+    unsigned height;
+    size_t pitch;
+    uint64_t host_run_ns; // Time spent in core_retro_run for the last frame
+
+    // Single-producer (host) / single-consumer (UI) audio ring, counted in stereo frames
+    std::atomic<uint32_t> audio_write;
+    std::atomic<uint32_t> audio_read;
+    uint64_t audio_dropped;
+    int16_t audio[SANDBOX_AUDIO_FRAMES * 2];
+
+    alignas(64) uint8_t video[SANDBOX_VIDEO_BYTES];
+};
+
+SandboxShared *g_shared = nullptr;
+pid_t g_host_pid = -1;
+
+// The mapping is MAP_SHARED across fork(), so these must not use FUTEX_PRIVATE_FLAG.
+static void futex_wait(std::atomic<uint32_t> *word, uint32_t expected, int timeout_ms)
+{
+    struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t> *word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void host_video_refresh(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+    if (!data || data == RETRO_HW_FRAME_BUFFER_VALID || (size_t)height * pitch > SANDBOX_VIDEO_BYTES)
+    {
+        // Dupe, or a frame we cannot forward; the UI keeps showing the previous one
+        g_shared->width = 0;
+        return;
+    }
+    std::memcpy(g_shared->video, data, (size_t)height * pitch);
+    g_shared->width = width;
+    g_shared->height = height;
+    g_shared->pitch = pitch;
+    sample_thumbnail(data, width, height, pitch);
+}
+
+size_t host_audio_sample_batch(const int16_t *data, size_t frames)
+{
+    uint32_t write = g_shared->audio_write.load(std::memory_order_relaxed);
+    uint32_t read = g_shared->audio_read.load(std::memory_order_acquire);
+    size_t space = SANDBOX_AUDIO_FRAMES - (write - read);
+    size_t count = std::min(frames, space);
 
-        // D-Pad (often handled as a hat)
-        Uint8 hat = SDL_JoystickGetHat(g_joystick, 0);
-        if (hat & SDL_HAT_UP)
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_UP] = 1;
-        if (hat & SDL_HAT_DOWN)
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_DOWN] = 1;
-        if (hat & SDL_HAT_LEFT)
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_LEFT] = 1;
-        if (hat & SDL_HAT_RIGHT)
-            g_joy_state[RETRO_DEVICE_ID_JOYPAD_RIGHT] = 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t slot = (write + i) & (SANDBOX_AUDIO_FRAMES - 1);
+        g_shared->audio[slot * 2] = data[i * 2];
+        g_shared->audio[slot * 2 + 1] = data[i * 2 + 1];
     }
+    g_shared->audio_write.store(write + count, std::memory_order_release);
+    g_shared->audio_dropped += frames - count;
+    return frames;
 }
 
-int16_t callback_input_state(unsigned port, unsigned /*device*/, unsigned /*index*/, unsigned id)
+void host_audio_sample(int16_t left, int16_t right)
+{
+    int16_t buf[2] = {left, right};
+    host_audio_sample_batch(buf, 1);
+}
+
+void host_input_poll(void)
+{
+    // The UI polls SDL and publishes the pad state before every frame request
+}
+
+int16_t host_input_state(unsigned port, unsigned /*device*/, unsigned /*index*/, unsigned id)
 {
     if (port == 0 && id < 16)
     {
-        // If joystick is active, it takes priority. Otherwise, use keyboard.
-        if (g_joystick)
-        {
-            return g_joy_state[id];
-        }
-        return g_keyboard_state[id];
+        return g_shared->input[id];
     }
-    return 0; // Only support one player
+    return 0;
 }
 
-// --- Helper Functions ---
+// Body of the forked host process. Never returns to main().
+[[noreturn]] void run_core_host(const std::string &core_path, const std::string &rom_path)
+{
+    // Die with the UI instead of lingering as an orphan
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
 
-#define LOAD_SYM(V, S)                                              \
-    do                                                              \
-    {                                                               \
-        V = (decltype(V))dlsym(g_core_handle, #S);                  \
-        if (!V)                                                     \
-            throw std::runtime_error("Failed to load symbol: " #S); \
-    } while (0)
+    try
+    {
+        auto rom_future = std::async(std::launch::async, read_rom, rom_path);
+        load_core(core_path);
+        core_retro_set_video_refresh(host_video_refresh);
+        core_retro_set_audio_sample(host_audio_sample);
+        core_retro_set_audio_sample_batch(host_audio_sample_batch);
+        core_retro_set_input_poll(host_input_poll);
+        core_retro_set_input_state(host_input_state);
 
-void load_core(const std::string &core_path)
-{
-    g_core_handle = dlopen(core_path.c_str(), RTLD_LAZY);
-    if (!g_core_handle)
+        core_retro_init();
+        g_rom_data = rom_future.get();
+        if (!load_rom(rom_path))
+        {
+            throw std::runtime_error("Failed to load ROM.");
+        }
+        core_retro_get_system_av_info(&g_av_info);
+        g_shared->av_info = g_av_info;
+        g_shared->pixel_format = g_pixel_format;
+        g_shared->rom_crc = g_rom_crc;
+        start_resume(rom_path);
+        place_emulation_thread({{g_rom_data.data(), g_rom_data.size()}, {g_shared, sizeof(SandboxShared)}});
+    }
+    catch (const std::exception &e)
     {
-        throw std::runtime_error("Failed to load core: " + core_path + " - " + dlerror());
+        snprintf(g_shared->error, sizeof(g_shared->error), "%s", e.what());
+        g_shared->host_state.store(HOST_FAILED, std::memory_order_release);
+        futex_wake(&g_shared->host_state);
+        _exit(1);
     }
 
-    // Load all the required libretro functions from the .so file
-    LOAD_SYM(core_retro_init, retro_init);
-    LOAD_SYM(core_retro_deinit, retro_deinit);
-    LOAD_SYM(core_retro_api_version, retro_api_version);
-    LOAD_SYM(core_retro_get_system_info, retro_get_system_info);
-    LOAD_SYM(core_retro_get_system_av_info, retro_get_system_av_info);
-    LOAD_SYM(core_retro_set_controller_port_device, retro_set_controller_port_device);
-    LOAD_SYM(core_retro_reset, retro_reset);
-    LOAD_SYM(core_retro_run, retro_run);
-    LOAD_SYM(core_retro_load_game, retro_load_game);
-    LOAD_SYM(core_retro_unload_game, retro_unload_game);
-    LOAD_SYM(core_retro_get_memory_data, retro_get_memory_data);
-    LOAD_SYM(core_retro_get_memory_size, retro_get_memory_size);
-    LOAD_SYM(core_retro_set_video_refresh, retro_set_video_refresh);
-    LOAD_SYM(core_retro_set_audio_sample, retro_set_audio_sample);
-    LOAD_SYM(core_retro_set_audio_sample_batch, retro_set_audio_sample_batch);
-    LOAD_SYM(core_retro_set_input_poll, retro_set_input_poll);
-    LOAD_SYM(core_retro_set_input_state, retro_set_input_state);
-    LOAD_SYM(core_retro_set_environment, retro_set_environment);
+    g_shared->host_state.store(HOST_READY, std::memory_order_release);
+    futex_wake(&g_shared->host_state);
 
-    // Set the callbacks
-    core_retro_set_environment(callback_environment);
-    core_retro_set_video_refresh(callback_video_refresh);
-    core_retro_set_audio_sample(callback_audio_sample);
-    core_retro_set_audio_sample_batch(callback_audio_sample_batch);
-    core_retro_set_input_poll(callback_input_poll);
-    core_retro_set_input_state(callback_input_state);
+    uint32_t seen = 0;
+    while (!g_shared->quit.load(std::memory_order_acquire))
+    {
+        uint32_t seq = g_shared->run_seq.load(std::memory_order_acquire);
+        if (seq == seen)
+        {
+            futex_wait(&g_shared->run_seq, seen, SANDBOX_POLL_MS);
+            continue;
+        }
+        seen = seq;
+
+        poll_option_files();
+        g_disc_swap_requests = g_shared->disc_swap_requests;
+        service_disk_control();
+        uint64_t start = now_ns();
+        run_core_frame(g_shared->fixed_frame_time);
+        g_shared->host_run_ns = now_ns() - start;
+        watch_frame();
+        service_memory("core host");
+        g_shared->av_info = g_av_info; // Forward SET_GEOMETRY/SET_SYSTEM_AV_INFO
+        g_frame_count++;
+
+        g_shared->done_seq.store(seq, std::memory_order_release);
+        futex_wake(&g_shared->done_seq);
+    }
+
+    suspend_to_state();
+    stop_disc_prefetch();
+    core_retro_unload_game();
+    core_retro_deinit();
+    stop_core_logger();
+    report_vfs_stats();
+    report_watch_stats();
+    report_memory("core host at exit");
+    _exit(0);
 }
 
-void init_sdl_gl()
+// Forks the core host. Must run before SDL is initialised so the child inherits none of it.
+void start_core_host(const std::string &core_path, const std::string &rom_path)
 {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK) != 0)
+    void *mem = mmap(nullptr, sizeof(SandboxShared), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED)
     {
-        throw std::runtime_error("Failed to initialize SDL: " + std::string(SDL_GetError()));
+        throw std::runtime_error("Failed to map sandbox memory: " + std::string(strerror(errno)));
     }
+    // Default-initialised: the fresh mapping is already zero, atomics included, and
+    // writing zeros over it would commit every page of the video and audio buffers
+    g_shared = new (mem) SandboxShared;
+    memory_track(MEM_SANDBOX, sizeof(SandboxShared));
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-
-    g_window = SDL_CreateWindow("Retro Launcher", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, SDL_WINDOW_OPENGL);
-    if (!g_window)
+    std::cout.flush();
+    g_host_pid = fork();
+    if (g_host_pid < 0)
     {
-        throw std::runtime_error("Failed to create SDL window: " + std::string(SDL_GetError()));
+        throw std::runtime_error("Failed to fork core host.");
     }
+    if (g_host_pid == 0)
+    {
+        run_core_host(core_path, rom_path);
+    }
+    g_memory_peer = g_host_pid;
+    std::cout << "Core host started with PID " << g_host_pid << std::endl;
+}
 
-    g_gl_context = SDL_GL_CreateContext(g_window);
-    if (!g_gl_context)
+// Describes why the host is gone, or returns an empty string while it is still alive.
+std::string check_core_host()
+{
+    int status = 0;
+    if (waitpid(g_host_pid, &status, WNOHANG) != g_host_pid)
     {
-        throw std::runtime_error("Failed to create OpenGL context: " + std::string(SDL_GetError()));
+        return "";
     }
-    SDL_GL_MakeCurrent(g_window, g_gl_context);
-    SDL_GL_SetSwapInterval(1); // Enable VSync
+    g_host_pid = -1;
+    g_memory_peer = -1;
 
-    // Initialize Joystick
-    if (SDL_NumJoysticks() > 0)
+    if (WIFSIGNALED(status))
     {
-        g_joystick = SDL_JoystickOpen(0);
-        if (g_joystick)
-        {
-            std::cout << "Joystick detected: " << SDL_JoystickName(g_joystick) << std::endl;
-        }
+        return std::string("The emulator core crashed (") + strsignal(WTERMSIG(status)) + ").";
     }
-    else
+    if (g_shared->host_state.load() == HOST_FAILED)
     {
-        std::cout << "No joystick detected. Using keyboard only." << std::endl;
+        return std::string("The emulator core failed to start: ") + g_shared->error;
     }
+    return "The emulator core exited unexpectedly (status " + std::to_string(WEXITSTATUS(status)) + ").";
 }
 
-void init_audio(double sample_rate)
+// Blocks until the host has loaded the core and ROM.
+void wait_for_core_host()
 {
-    SDL_AudioSpec want, have;
-    SDL_zero(want);
-    want.freq = static_cast<int>(sample_rate);
-    want.format = AUDIO_S16SYS;
-    want.channels = 2;
-    want.samples = 1024;
-    want.callback = NULL; // We will queue audio
-
-    g_audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
-    if (g_audio_device == 0)
+    for (;;)
     {
-        throw std::runtime_error("Failed to open audio device: " + std::string(SDL_GetError()));
+        uint32_t state = g_shared->host_state.load(std::memory_order_acquire);
+        if (state == HOST_READY)
+        {
+            g_pixel_format = g_shared->pixel_format;
+            return;
+        }
+        std::string failure = check_core_host();
+        if (!failure.empty())
+        {
+            throw std::runtime_error(failure);
+        }
+        futex_wait(&g_shared->host_state, state, SANDBOX_POLL_MS);
     }
-    SDL_PauseAudioDevice(g_audio_device, 0); // Start playing
 }
 
-bool load_rom(const std::string &rom_path)
+// Runs one frame in the host. Returns false (with the reason in 'failure') if the host died.
+bool run_sandboxed_frame(std::string &failure)
 {
-    // The core will handle loading from the path, but some cores require the data
-    // to be loaded into memory first. We will do both.
-    std::vector<uint8_t> rom_data;
-    struct retro_game_info game_info = {};
-    game_info.path = rom_path.c_str();
+    for (unsigned id = 0; id < 16; ++id)
+    {
+        g_shared->input[id] = callback_input_state(0, RETRO_DEVICE_JOYPAD, 0, id);
+    }
+    g_shared->disc_swap_requests = g_disc_swap_requests;
+    g_shared->fixed_frame_time = g_unthrottled;
 
-    std::ifstream file(rom_path, std::ios::binary | std::ios::ate);
-    if (file)
+    uint32_t seq = g_shared->run_seq.load(std::memory_order_relaxed) + 1;
+    g_shared->run_seq.store(seq, std::memory_order_release);
+    futex_wake(&g_shared->run_seq);
+
+    for (;;)
     {
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        rom_data.resize(size);
-        if (file.read((char *)rom_data.data(), size))
+        uint32_t done = g_shared->done_seq.load(std::memory_order_acquire);
+        if (done == seq)
+        {
+            break;
+        }
+        failure = check_core_host();
+        if (!failure.empty())
         {
-            game_info.data = rom_data.data();
-            game_info.size = rom_data.size();
+            return false;
         }
+        futex_wait(&g_shared->done_seq, done, SANDBOX_POLL_MS);
     }
-    else
+
+    // Drain the audio ring (at most two contiguous spans)
+    uint32_t read = g_shared->audio_read.load(std::memory_order_relaxed);
+    uint32_t write = g_shared->audio_write.load(std::memory_order_acquire);
+    while (read != write)
     {
-        std::cerr << "Failed to open ROM file: " << rom_path << std::endl;
-        return false;
+        uint32_t slot = read & (SANDBOX_AUDIO_FRAMES - 1);
+        uint32_t count = std::min(write - read, SANDBOX_AUDIO_FRAMES - slot);
+        if (!g_unthrottled)
+            SDL_QueueAudio(g_audio_device, &g_shared->audio[slot * 2], count * 2 * sizeof(int16_t));
+        capture_audio(&g_shared->audio[slot * 2], count);
+        read += count;
     }
+    g_shared->audio_read.store(read, std::memory_order_release);
 
-    if (!core_retro_load_game(&game_info))
+    // The frame is read straight out of shared memory; the host is idle until the next request
+    g_av_info = g_shared->av_info;
+    if (g_shared->width > 0)
     {
-        std::cerr << "The core failed to load the game." << std::endl;
-        return false;
+        callback_video_refresh(g_shared->video, g_shared->width, g_shared->height, g_shared->pitch);
+    }
+    else
+    {
+        callback_video_refresh(nullptr, 0, 0, 0);
     }
     return true;
 }
 
-void cleanup()
+void stop_core_host()
 {
-    if (core_retro_unload_game)
-        core_retro_unload_game();
-    if (core_retro_deinit)
-        core_retro_deinit();
-    if (g_core_handle)
-        dlclose(g_core_handle);
+    if (!g_shared)
+        return;
 
-    if (g_joystick)
-        SDL_JoystickClose(g_joystick);
-    if (g_audio_device > 0)
-        SDL_CloseAudioDevice(g_audio_device);
-    if (g_gl_context)
-        SDL_GL_DeleteContext(g_gl_context);
-    if (g_window)
-        SDL_DestroyWindow(g_window);
-    SDL_Quit();
+    g_shared->quit.store(1, std::memory_order_release);
+    futex_wake(&g_shared->run_seq);
+
+    // Give the core a moment to unload cleanly, then make sure it is gone
+    for (int i = 0; i < 20 && g_host_pid > 0; ++i)
+    {
+        if (waitpid(g_host_pid, nullptr, WNOHANG) == g_host_pid)
+        {
+            g_host_pid = -1;
+            break;
+        }
+        usleep(50000);
+    }
+    if (g_host_pid > 0)
+    {
+        kill(g_host_pid, SIGKILL);
+        waitpid(g_host_pid, nullptr, 0);
+        g_host_pid = -1;
+    }
+
+    munmap(g_shared, sizeof(SandboxShared));
+    g_shared = nullptr;
+}
+
+// Main loop for split-process mode. Returns false if the core host died.
+bool run_sandboxed()
+{
+    uint64_t frames = 0;
+    uint64_t core_ns = 0;
+    uint64_t overhead_ns = 0;
+    uint64_t worst_overhead_ns = 0;
+    std::string failure;
+
+    while (g_running)
+    {
+        callback_input_poll();
+        update_throttle();
+        if (g_memory_reports != g_memory_report_requests && g_host_pid > 0)
+        {
+            kill(g_host_pid, SIGUSR1); // The core's memory is in the host
+        }
+        service_memory("frontend");
+
+        uint64_t start = now_ns();
+        if (!run_sandboxed_frame(failure))
+        {
+            std::cerr << "FATAL ERROR: " << failure << std::endl;
+            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Dendy",
+                                     (failure + "\nReturning to the launcher.").c_str(), g_window);
+            return false;
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        // Everything not spent inside retro_run is the cost of the process split
+        uint64_t overhead = elapsed > g_shared->host_run_ns ? elapsed - g_shared->host_run_ns : 0;
+        core_ns += g_shared->host_run_ns;
+        overhead_ns += overhead;
+        worst_overhead_ns = std::max(worst_overhead_ns, overhead);
+        frames++;
+
+        if (throttle_present())
+        {
+            present_frame();
+            SDL_GL_SwapWindow(g_window);
+        }
+        if (!g_unthrottled)
+            record_frame_timing(g_shared->host_run_ns);
+        if (frames == 1)
+        {
+            trace_startup("time-to-first-frame", g_startup_ns);
+        }
+    }
+
+    if (frames > 0)
+    {
+        double frame_us = 1e6 / g_shared->av_info.timing.fps;
+        double avg_overhead_us = overhead_ns / 1000.0 / frames;
+        std::cout << "Sandbox: " << frames << " frames, core " << core_ns / 1000.0 / frames
+                  << " us/frame, IPC overhead " << avg_overhead_us << " us/frame (max "
+                  << worst_overhead_ns / 1000.0 << " us, " << 100.0 * avg_overhead_us / frame_us
+                  << "% of frame time)" << std::endl;
+        if (g_shared->audio_dropped > 0)
+        {
+            std::cout << "Sandbox: dropped " << g_shared->audio_dropped << " audio frames" << std::endl;
+        }
+    }
+    return true;
 }
 
 // --- Main Application ---
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    std::string rom_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--sandbox")
+        {
+            g_sandbox = true;
+        }
+        else if (arg == "--no-resume")
+        {
+            g_resume = false;
+        }
+        else if (arg == "--record")
+        {
+            g_record = true;
+        }
+        else if (arg == "--integer-scale")
+        {
+            g_present_scale = SCALE_INTEGER;
+        }
+        else if (arg == "--nearest")
+        {
+            g_present_filter = FILTER_NEAREST;
+        }
+        else if (arg == "--watch" && i + 1 < argc)
+        {
+            g_watch_file = argv[++i];
+        }
+        else if (arg == "--watch-bench")
+        {
+            g_watch_bench = true;
+        }
+        else if (arg == "--netplay-host" && i + 1 < argc)
+        {
+            g_net_host_port = std::atoi(argv[++i]);
+        }
+        else if (arg == "--netplay-join" && i + 1 < argc)
+        {
+            g_net_join = argv[++i];
+        }
+        else if (arg == "--netplay-delay" && i + 1 < argc)
+        {
+            g_net_delay = std::clamp(std::atoi(argv[++i]), 0, 8);
+        }
+        else if (arg == "--netplay-latency" && i + 1 < argc)
+        {
+            g_net_latency_ms = std::atoi(argv[++i]);
+        }
+        else if (arg == "--netplay-loss" && i + 1 < argc)
+        {
+            g_net_loss_percent = std::atoi(argv[++i]);
+        }
+        else if (arg == "--memory-budget" && i + 1 < argc)
+        {
+            g_memory_budget = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        }
+        else if (arg == "--benchmark")
+        {
+            g_benchmark = true;
+        }
+        else if (arg == "--realtime")
+        {
+            g_realtime = true;
+        }
+        else if (arg == "--pin-cpu" && i + 1 < argc)
+        {
+            g_realtime = true;
+            g_pin_cpu = std::atoi(argv[++i]);
+        }
+        else
+        {
+            rom_path = arg;
+        }
+    }
+
+    if (rom_path.empty())
     {
-        std::cerr << "Usage: " << argv[0] << " <path-to-rom>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--sandbox] [--no-resume] [--record] [--integer-scale] [--nearest] [--watch <file>] [--watch-bench] [--benchmark] [--memory-budget <MB>] [--realtime] [--pin-cpu <n>]"
+                  << " [--netplay-host <port> | --netplay-join <host:port>] [--netplay-delay <frames>]"
+                  << " [--netplay-latency <ms>] [--netplay-loss <percent>] <path-to-rom>" << std::endl;
         return 1;
     }
+    if (g_net_host_port || !g_net_join.empty())
+    {
+        // Both sides must start from power-on, and rollback serializes the core in-process
+        g_resume = false;
+        if (g_sandbox)
+        {
+            std::cout << "[netplay] Rollback needs the core in-process; ignoring --sandbox" << std::endl;
+            g_sandbox = false;
+        }
+    }
 
-    std::string rom_path = argv[1];
     std::string core_path;
+    bool core_crashed = false;
+
+    // SIGTERM (e.g. from the window manager) ends the session like a window close,
+    // so the game is suspended instead of lost
+    struct sigaction sa = {};
+    sa.sa_handler = handle_terminate_signal;
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+    sa.sa_handler = handle_memory_report_signal;
+    sigaction(SIGUSR1, &sa, nullptr);
 
     try
     {
@@ -401,50 +5041,118 @@ int main(int argc, char *argv[])
         }
         // On Debian, cores are in a standard path
         core_path = "/usr/lib/x86_64-linux-gnu/libretro/" + it->second;
+        g_option_core = it->second.substr(0, it->second.find("_libretro"));
+        g_option_game = std::filesystem::path(rom_path).stem().string();
 
         std::cout << "ROM: " << rom_path << std::endl;
         std::cout << "Core: " << core_path << std::endl;
 
-        // Initialization
-        init_sdl_gl();
-        load_core(core_path);
+        if (g_sandbox)
+        {
+            // The host loads the core and ROM while we bring up the window
+            start_core_host(core_path, rom_path);
+            init_sdl_gl();
+            wait_for_core_host();
+            g_av_info = g_shared->av_info;
+            g_rom_crc = g_shared->rom_crc;
+            apply_perf_profile();
+            init_audio(g_av_info.timing.sample_rate);
+            start_capture(g_av_info, rom_path);
+            if (g_realtime)
+                lock_memory({{g_shared, sizeof(SandboxShared)}}); // The core runs in the host
 
-        core_retro_init();
+            core_crashed = !run_sandboxed();
+        }
+        else
+        {
+            // Initialization. The ROM read and the core dlopen don't depend on SDL,
+            // so they run on worker threads while the window and GL context come up.
+            auto rom_future = std::async(std::launch::async, read_rom, rom_path);
+            auto core_future = std::async(std::launch::async, load_core, core_path);
+            init_sdl_gl();
+            core_future.get();
 
-        // Get timing info from core and initialize audio
-        struct retro_system_av_info av_info;
-        core_retro_get_system_av_info(&av_info);
-        init_audio(av_info.timing.sample_rate);
+            uint64_t init_start = now_ns();
+            core_retro_init();
+            trace_startup("retro_init", init_start);
 
-        // Window size might be based on core geometry
-        int w_width, w_height;
-        SDL_GetWindowSize(g_window, &w_width, &w_height);
-        glViewport(0, 0, w_width, w_height);
+            // Get timing info from core and initialize audio
+            g_rom_data = rom_future.get();
+            apply_perf_profile();
+            core_retro_get_system_av_info(&g_av_info);
+            init_audio(g_av_info.timing.sample_rate);
+            bool audio_pulled = g_audio_callback.callback != nullptr; // Registered in retro_init
 
-        if (!load_rom(rom_path))
-        {
-            throw std::runtime_error("Failed to load ROM.");
-        }
+            if (!load_rom(rom_path))
+            {
+                throw std::runtime_error("Failed to load ROM.");
+            }
+            start_resume(rom_path);
+            core_retro_get_system_av_info(&g_av_info); // Final now that the game is loaded
+            if (g_audio_callback.callback && !audio_pulled)
+            {
+                // Registered while the game loaded; reopen the device in pull mode
+                SDL_CloseAudioDevice(g_audio_device);
+                init_audio(g_av_info.timing.sample_rate);
+            }
+            start_audio_callback();
+            start_capture(g_av_info, rom_path);
+            place_emulation_thread({{g_rom_data.data(), g_rom_data.size()}});
+            start_netplay();
 
-        // Main loop
-        while (g_running)
-        {
-            // Poll input inside loop as well to catch quit events
-            callback_input_poll();
+            // Main loop
+            bool first_frame = true;
+            while (g_running)
+            {
+                // Poll input inside loop as well to catch quit events
+                callback_input_poll();
+                update_throttle();
+                poll_option_files();
+                service_disk_control();
+                service_memory("frontend");
 
-            core_retro_run();
-            SDL_GL_SwapWindow(g_window);
+                uint64_t run_start = now_ns();
+                bool ran = true;
+                if (g_net.active)
+                    ran = netplay_run_frame();
+                else
+                    run_core_frame(g_unthrottled);
+                uint64_t run_ns = now_ns() - run_start;
+                if (ran)
+                    watch_frame();
+                if (throttle_present())
+                {
+                    present_frame();
+                    SDL_GL_SwapWindow(g_window);
+                }
+                if (ran)
+                {
+                    g_frame_count++;
+                    if (!g_unthrottled)
+                        record_frame_timing(run_ns);
+                }
+
+                if (first_frame)
+                {
+                    trace_startup("time-to-first-frame", g_startup_ns);
+                    first_frame = false;
+                }
+            }
+
+            suspend_to_state();
         }
     }
     catch (const std::exception &e)
     {
         std::cerr << "FATAL ERROR: " << e.what() << std::endl;
+        stop_core_host();
         cleanup();
         return 1;
     }
 
     // Cleanup
     std::cout << "Exiting..." << std::endl;
+    stop_core_host();
     cleanup();
-    return 0;
-}
\ No newline at end of file
+    return core_crashed ? 1 : 0;
+}
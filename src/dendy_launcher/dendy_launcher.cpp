@@ -1,9 +1,11 @@
 // dendy_launcher.cpp
 
 #include "include/raylib.h"
+#include "include/rlgl.h"
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <fstream>
 #include <sstream>
@@ -11,6 +13,24 @@
 #include <cmath>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 
 namespace fs = std::filesystem;
 
@@ -36,6 +56,12 @@ constexpr float FADE_IN_DURATION = 0.1f;
 constexpr float TILE_STAGGER_DELAY = 0.03f;
 constexpr float TILE_ANIMATION_DURATION = 0.5f;
 constexpr float LAUNCH_ANIMATION_DURATION = 0.6f;
+constexpr int MAX_ICON_WORKERS = 4;
+constexpr double ICON_UPLOAD_BUDGET = 0.004; // Seconds of each frame spent uploading icons
+constexpr int WATCH_SETTLE_MS = 200;          // Quiet time before changed desktop files are parsed
+constexpr double IDLE_POLL_INTERVAL = 1.0 / 60;  // Input polling while idle in front
+constexpr double BACKGROUND_POLL_INTERVAL = 0.1; // Polling while another window has focus
+constexpr float MAX_FRAME_TIME = 0.1f;           // Animation step cap after an idle stretch
 
 enum AnimationState
 {
@@ -68,14 +94,64 @@ bool hasEnding(std::string const &fullString, std::string const &ending)
     }
 }
 
+// Where the launcher keeps its caches ($XDG_CACHE_HOME/dendy or ~/.cache/dendy)
+std::string GetCacheDirectory()
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0])
+        return std::string(xdg) + "/dendy";
+
+    std::string home = getenv("HOME") ? getenv("HOME") : "";
+    if (home.empty())
+        return "";
+    return home + "/.cache/dendy";
+}
+
+// Where per-user installs put their .desktop files, or "" without a home
+std::string GetUserApplicationDirectory()
+{
+    std::string home = getenv("HOME") ? getenv("HOME") : "";
+    if (home.empty())
+        return "";
+    return home + "/.local/share/applications";
+}
+
+std::vector<std::string> GetApplicationDirectories()
+{
+    std::vector<std::string> dirs = {"/usr/share/applications", "/usr/local/share/applications"};
+
+    // Load from user directory
+    std::string userDir = GetUserApplicationDirectory();
+    if (!userDir.empty())
+    {
+        dirs.push_back(userDir);
+    }
+    return dirs;
+}
+
+// One stat for the (mtime in ns, size) pair the caches use to spot changes
+bool GetFileStamp(const std::string &path, int64_t &mtime, int64_t &size)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    size = st.st_size;
+    return true;
+}
+
 class AppEntry
 {
 public:
     std::string name;
     std::string exec;
     std::string icon;
-    Texture2D texture;
-    bool hasTexture;
+    std::string desktopFile; // Source .desktop path, used to match live updates
+    Texture2D iconAtlas; // Shared atlas page, owned by IconAtlas
+    Rectangle iconRect;  // Icon area within iconAtlas
+    Texture2D labelAtlas; // Pre-rendered name, owned by LabelAtlas
+    Rectangle labelRect;  // Label area within labelAtlas, flipped
+    bool hasIcon;
     float scale;
     float targetScale;
 
@@ -85,63 +161,16 @@ public:
     Vector2 animOffset;
     float opacity;
 
-    AppEntry() : hasTexture(false), scale(1.0f), targetScale(1.0f),
+    AppEntry() : iconAtlas({}), iconRect({0, 0, 0, 0}), labelAtlas({}), labelRect({0, 0, 0, 0}), hasIcon(false), scale(1.0f), targetScale(1.0f),
                  animDelay(0.0f), animProgress(0.0f), animOffset({0, 0}), opacity(0.0f) {}
 
-    ~AppEntry()
-    {
-        if (hasTexture)
-        {
-            UnloadTexture(texture);
-        }
-    }
-
-    // Disable copy to avoid texture issues
-    AppEntry(const AppEntry &) = delete;
-    AppEntry &operator=(const AppEntry &) = delete;
-
-    // Enable move
-    AppEntry(AppEntry &&other) noexcept
-        : name(std::move(other.name)),
-          exec(std::move(other.exec)),
-          icon(std::move(other.icon)),
-          texture(other.texture),
-          hasTexture(other.hasTexture),
-          scale(other.scale),
-          targetScale(other.targetScale),
-          animDelay(other.animDelay),
-          animProgress(other.animProgress),
-          animOffset(other.animOffset),
-          opacity(other.opacity)
-    {
-        other.hasTexture = false;
-    }
-
-    AppEntry &operator=(AppEntry &&other) noexcept
-    {
-        if (this != &other)
-        {
-            if (hasTexture)
-                UnloadTexture(texture);
-            name = std::move(other.name);
-            exec = std::move(other.exec);
-            icon = std::move(other.icon);
-            texture = other.texture;
-            hasTexture = other.hasTexture;
-            scale = other.scale;
-            targetScale = other.targetScale;
-            animDelay = other.animDelay;
-            animProgress = other.animProgress;
-            animOffset = other.animOffset;
-            opacity = other.opacity;
-            other.hasTexture = false;
-        }
-        return *this;
-    }
-
     void UpdateAnimation()
     {
         scale += (targetScale - scale) * ANIMATION_SPEED;
+        if (std::fabs(targetScale - scale) < 0.001f)
+        {
+            scale = targetScale; // Settle, so an idle grid is exactly still
+        }
     }
 
     void UpdateFadeInAnimation(float deltaTime)
@@ -198,224 +227,940 @@ public:
     }
 };
 
+// Desktop Entry Specification parser working on the file's bytes through
+// std::string_view: small files are read into a reused buffer, large ones
+// mapped. Only the values that are kept get copied.
 class DesktopFileParser
 {
+public:
+    struct DesktopEntry
+    {
+        bool visible = false; // Application with name and exec, not hidden, shown here
+        std::string name;
+        std::string exec;
+        std::string icon;
+        std::string tryExec; // Checked when the entry is used, not when parsed
+    };
+
 private:
-    static std::string Trim(const std::string &str)
+    static std::string_view Trim(std::string_view str)
+    {
+        size_t first = str.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos)
+            return {};
+        size_t last = str.find_last_not_of(" \t\r");
+        return str.substr(first, last - first + 1);
+    }
+
+    // Resolves \s \n \t \r and \\ in string values
+    static std::string Unescape(std::string_view value)
+    {
+        std::string out;
+        out.reserve(value.size());
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            if (value[i] != '\\' || i + 1 == value.size())
+            {
+                out += value[i];
+                continue;
+            }
+
+            switch (value[++i])
+            {
+            case 's':
+                out += ' ';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            default:
+                // Not a string escape (e.g. \" in Exec); keep it for the shell
+                out += '\\';
+                out += value[i];
+                break;
+            }
+        }
+        return out;
+    }
+
+    static std::string ShellQuote(const std::string &value)
+    {
+        std::string out = "'";
+        for (char c : value)
+        {
+            if (c == '\'')
+                out += "'\\''";
+            else
+                out += c;
+        }
+        return out + "'";
+    }
+
+    // Locale keys to accept for Name[...], best first: lang_COUNTRY@MODIFIER,
+    // lang_COUNTRY, lang@MODIFIER, lang (from LC_ALL, LC_MESSAGES or LANG)
+    static const std::vector<std::string> &GetLocaleKeys()
     {
-        size_t first = str.find_first_not_of(" \t\n\r");
-        if (first == std::string::npos)
-            return "";
-        size_t last = str.find_last_not_of(" \t\n\r");
-        return str.substr(first, (last - first + 1));
+        static const std::vector<std::string> keys = []
+        {
+            std::vector<std::string> result;
+            const char *vars[] = {"LC_ALL", "LC_MESSAGES", "LANG"};
+            std::string locale;
+            for (const char *var : vars)
+            {
+                const char *value = getenv(var);
+                if (value && value[0])
+                {
+                    locale = value;
+                    break;
+                }
+            }
+            if (locale.empty() || locale == "C" || locale == "POSIX")
+                return result;
+
+            std::string modifier;
+            size_t at = locale.find('@');
+            if (at != std::string::npos)
+            {
+                modifier = locale.substr(at);
+                locale.erase(at);
+            }
+            size_t dot = locale.find('.');
+            if (dot != std::string::npos)
+                locale.erase(dot);
+
+            std::string lang = locale.substr(0, locale.find('_'));
+            bool hasCountry = locale.size() > lang.size();
+            if (hasCountry && !modifier.empty())
+                result.push_back(locale + modifier);
+            if (hasCountry)
+                result.push_back(locale);
+            if (!modifier.empty())
+                result.push_back(lang + modifier);
+            result.push_back(lang);
+            return result;
+        }();
+        return keys;
+    }
+
+    // The desktops named in XDG_CURRENT_DESKTOP, for OnlyShowIn and NotShowIn
+    static bool MatchesCurrentDesktop(std::string_view list)
+    {
+        static const std::string current = getenv("XDG_CURRENT_DESKTOP") ? getenv("XDG_CURRENT_DESKTOP") : "";
+
+        std::string_view desktops = current;
+        while (!desktops.empty())
+        {
+            size_t colon = desktops.find(':');
+            std::string_view desktop = desktops.substr(0, colon);
+            desktops = colon == std::string_view::npos ? std::string_view() : desktops.substr(colon + 1);
+
+            std::string_view items = list;
+            while (!items.empty())
+            {
+                size_t semicolon = items.find(';');
+                if (items.substr(0, semicolon) == desktop)
+                    return true;
+                items = semicolon == std::string_view::npos ? std::string_view() : items.substr(semicolon + 1);
+            }
+        }
+        return false;
+    }
+
+    // Strips file and URL field codes, expands %c, %k, %i and %%
+    static std::string ExpandFieldCodes(const std::string &exec, const DesktopEntry &entry, const std::string &path)
+    {
+        std::string out;
+        out.reserve(exec.size());
+        for (size_t i = 0; i < exec.size(); i++)
+        {
+            if (exec[i] != '%' || i + 1 == exec.size())
+            {
+                out += exec[i];
+                continue;
+            }
+
+            switch (exec[++i])
+            {
+            case '%':
+                out += '%';
+                break;
+            case 'c':
+                out += ShellQuote(entry.name);
+                break;
+            case 'k':
+                out += ShellQuote(path);
+                break;
+            case 'i':
+                if (!entry.icon.empty())
+                    out += "--icon " + ShellQuote(entry.icon);
+                break;
+            default:
+                // %f %F %u %U and the deprecated codes: nothing to pass
+                break;
+            }
+        }
+
+        size_t last = out.find_last_not_of(" \t");
+        out.erase(last == std::string::npos ? 0 : last + 1);
+        return out;
+    }
+
+    static bool IsTrue(std::string_view value)
+    {
+        return value == "true";
     }
 
 public:
-    static std::unique_ptr<AppEntry> ParseFile(const fs::path &filepath)
+    // An absolute path that is executable, or a name found on PATH
+    static bool IsExecutableAvailable(const std::string &program)
     {
-        std::ifstream file(filepath);
-        if (!file.is_open())
-            return nullptr;
+        if (program.find('/') != std::string::npos)
+            return access(program.c_str(), X_OK) == 0;
 
-        auto app = std::make_unique<AppEntry>();
-        std::string line;
+        const char *path = getenv("PATH");
+        std::string_view dirs = path ? path : "/usr/local/bin:/usr/bin:/bin";
+        while (!dirs.empty())
+        {
+            size_t colon = dirs.find(':');
+            std::string candidate(dirs.substr(0, colon));
+            candidate += '/';
+            candidate += program;
+            if (access(candidate.c_str(), X_OK) == 0)
+                return true;
+            dirs = colon == std::string_view::npos ? std::string_view() : dirs.substr(colon + 1);
+        }
+        return false;
+    }
+
+    static DesktopEntry ParseBuffer(std::string_view data, const std::string &path)
+    {
+        DesktopEntry entry;
+        const std::vector<std::string> &localeKeys = GetLocaleKeys();
+        std::string_view name, exec, icon, tryExec;
+        size_t nameRank = SIZE_MAX;
         bool inDesktopEntry = false;
-        bool isValid = true;
+        bool sawDesktopEntry = false;
+        bool hidden = false;
+        bool isApplication = true;
 
-        while (std::getline(file, line))
+        while (!data.empty())
         {
-            line = Trim(line);
+            size_t newline = data.find('\n');
+            std::string_view line = Trim(data.substr(0, newline));
+            data = newline == std::string_view::npos ? std::string_view() : data.substr(newline + 1);
+
+            if (line.empty() || line[0] == '#')
+                continue;
 
-            if (line == "[Desktop Entry]")
+            if (line[0] == '[')
             {
-                inDesktopEntry = true;
+                // [Desktop Entry] comes first; later groups are actions and the like
+                if (sawDesktopEntry)
+                    break;
+                inDesktopEntry = line == "[Desktop Entry]";
+                sawDesktopEntry = inDesktopEntry;
+                continue;
             }
-            else if (hasBeginning(line, "["))
+            if (!inDesktopEntry)
+                continue;
+
+            size_t equals = line.find('=');
+            if (equals == std::string_view::npos)
+                continue;
+            std::string_view key = Trim(line.substr(0, equals));
+            std::string_view value = Trim(line.substr(equals + 1));
+
+            std::string_view locale;
+            size_t bracket = key.find('[');
+            if (bracket != std::string_view::npos && key.back() == ']')
             {
-                inDesktopEntry = false;
+                locale = key.substr(bracket + 1, key.size() - bracket - 2);
+                key = key.substr(0, bracket);
             }
-            else if (inDesktopEntry && !line.empty())
+
+            if (key == "Name")
             {
-                if (hasBeginning(line, "Name=") && app->name.empty())
-                {
-                    app->name = line.substr(5);
-                }
-                else if (hasBeginning(line, "Exec="))
-                {
-                    app->exec = line.substr(5);
-                    // Remove field codes like %f, %F, %u, %U
-                    size_t pos = app->exec.find(" %");
-                    if (pos != std::string::npos)
-                    {
-                        app->exec = app->exec.substr(0, pos);
-                    }
-                }
-                else if (hasBeginning(line, "Icon="))
+                // Unlocalized is the fallback, ranked after every locale key
+                size_t rank = localeKeys.size();
+                if (!locale.empty())
                 {
-                    app->icon = line.substr(5);
+                    auto match = std::find(localeKeys.begin(), localeKeys.end(), locale);
+                    if (match == localeKeys.end())
+                        continue;
+                    rank = match - localeKeys.begin();
                 }
-                else if (line == "NoDisplay=true" || line == "Hidden=true")
+                if (rank < nameRank)
                 {
-                    isValid = false;
-                    break;
+                    nameRank = rank;
+                    name = value;
                 }
             }
+            else if (!locale.empty())
+            {
+                continue;
+            }
+            else if (key == "Exec")
+            {
+                exec = value;
+            }
+            else if (key == "Icon")
+            {
+                icon = value;
+            }
+            else if (key == "TryExec")
+            {
+                tryExec = value;
+            }
+            else if (key == "Type")
+            {
+                isApplication = value == "Application";
+            }
+            else if (key == "NoDisplay" || key == "Hidden")
+            {
+                hidden = hidden || IsTrue(value);
+            }
+            else if (key == "OnlyShowIn")
+            {
+                hidden = hidden || !MatchesCurrentDesktop(value);
+            }
+            else if (key == "NotShowIn")
+            {
+                hidden = hidden || MatchesCurrentDesktop(value);
+            }
+        }
+
+        if (!sawDesktopEntry || hidden || !isApplication || name.empty() || exec.empty())
+            return entry;
+
+        entry.visible = true;
+        entry.name = Unescape(name);
+        entry.icon = Unescape(icon);
+        entry.tryExec = Unescape(tryExec);
+        entry.exec = ExpandFieldCodes(Unescape(exec), entry, path);
+        return entry;
+    }
+
+    static DesktopEntry Parse(const fs::path &filepath)
+    {
+        // Typical desktop files are a few KB, where mmap and munmap cost more
+        // than a read into a reused buffer; map only the big translated ones
+        constexpr off_t MAP_THRESHOLD = 64 * 1024;
+        thread_local std::vector<char> buffer;
+
+        std::string path = filepath.string();
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return {};
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return {};
+        }
+
+        DesktopEntry entry;
+        if (st.st_size >= MAP_THRESHOLD)
+        {
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                entry = ParseBuffer(std::string_view((const char *)data, st.st_size), path);
+                munmap(data, st.st_size);
+            }
+        }
+        else if (st.st_size > 0)
+        {
+            if (buffer.size() < (size_t)st.st_size)
+                buffer.resize(st.st_size);
+
+            size_t length = 0;
+            ssize_t got;
+            while (length < (size_t)st.st_size && (got = read(fd, buffer.data() + length, st.st_size - length)) > 0)
+            {
+                length += got;
+            }
+            entry = ParseBuffer(std::string_view(buffer.data(), length), path);
         }
+        close(fd);
+        return entry;
+    }
 
-        if (!isValid || app->name.empty() || app->exec.empty())
+    static std::unique_ptr<AppEntry> ParseFile(const fs::path &filepath)
+    {
+        DesktopEntry entry = Parse(filepath);
+        if (!entry.visible || (!entry.tryExec.empty() && !IsExecutableAvailable(entry.tryExec)))
         {
             return nullptr;
         }
 
+        auto app = std::make_unique<AppEntry>();
+        app->name = std::move(entry.name);
+        app->exec = std::move(entry.exec);
+        app->icon = std::move(entry.icon);
         return app;
     }
 };
 
-class IconLoader
+// Parsed desktop entries from previous runs, stored per directory with the
+// directory's mtime and each file's mtime and size. A directory whose mtime
+// is unchanged is not listed again; its known files are only stat'ed, and
+// only files that changed are parsed again.
+class DesktopIndex
 {
 private:
-    static std::vector<std::string> GetIconSearchPaths()
+    static constexpr char MAGIC[8] = {'D', 'N', 'D', 'Y', 'A', 'P', 'P', 'S'};
+    static constexpr uint32_t VERSION = 3;
+    // Directory mtimes move in kernel ticks; a file created in the same tick
+    // as the listing leaves the mtime the index recorded
+    static constexpr int64_t MTIME_SLACK_NS = 2000000000;
+
+    struct FileRecord
     {
-        std::vector<std::string> paths = {
-            "/usr/share/icons/hicolor",
-            "/usr/share/icons/gnome",
-            "/usr/share/icons/Adwaita",
-            "/usr/share/pixmaps"};
+        int64_t mtime = 0;
+        int64_t size = 0;
+        bool visible = false; // False for NoDisplay, Hidden and incomplete entries
+        std::string name;
+        std::string exec;
+        std::string icon;
+        std::string tryExec;
+    };
+
+    struct DirRecord
+    {
+        int64_t mtime = 0;
+        std::map<std::string, FileRecord> files;
+    };
+
+    std::string indexPath;
+    std::map<std::string, DirRecord> dirs;
+    int64_t written = 0; // When the loaded index was saved, in ns since the epoch
+    bool dirty = false;
+    int parsed = 0;
+    int reused = 0;
+
+    static FileRecord ParseRecord(const fs::path &path, int64_t mtime, int64_t size)
+    {
+        DesktopFileParser::DesktopEntry entry = DesktopFileParser::Parse(path);
+        FileRecord record;
+        record.mtime = mtime;
+        record.size = size;
+        record.visible = entry.visible;
+        record.name = std::move(entry.name);
+        record.exec = std::move(entry.exec);
+        record.icon = std::move(entry.icon);
+        record.tryExec = std::move(entry.tryExec);
+        return record;
+    }
 
-        // Add Waydroid-specific paths
-        std::string home = getenv("HOME") ? getenv("HOME") : "";
-        if (!home.empty())
+    // Parsed names and visibility depend on the locale and the desktop
+    static std::string GetEnvironmentKey()
+    {
+        std::string key;
+        for (const char *var : {"LC_ALL", "LC_MESSAGES", "LANG", "XDG_CURRENT_DESKTOP"})
         {
-            // Waydroid typically stores icons in these locations
-            paths.push_back(home + "/.local/share/icons/hicolor");
-            paths.push_back(home + "/.local/share/icons");
-            paths.push_back(home + "/.local/share/pixmaps");
-            paths.push_back(home + "/.local/share/waydroid-extra/icons");
+            key += getenv(var) ? getenv(var) : "";
+            key += '|';
+        }
+        return key;
+    }
 
-            // Check for Waydroid data directory
-            std::string waydroidData = home + "/.local/share/waydroid/data";
-            if (fs::exists(waydroidData))
+    // Re-stats the files a directory held last time. Returns false when one
+    // has disappeared, which calls for a full listing.
+    bool RefreshKnownFiles(const fs::path &dir, DirRecord &record)
+    {
+        for (auto &[filename, file] : record.files)
+        {
+            int64_t mtime = 0, size = 0;
+            if (!GetFileStamp((dir / filename).string(), mtime, size))
+                return false;
+
+            if (mtime != file.mtime || size != file.size)
             {
-                paths.push_back(waydroidData + "/icons");
+                file = ParseRecord(dir / filename, mtime, size);
+                parsed++;
+                dirty = true;
+            }
+            else
+            {
+                reused++;
             }
         }
+        return true;
+    }
 
-        // Also check system-wide Waydroid locations
-        paths.push_back("/var/lib/waydroid/images/icons");
-        paths.push_back("/usr/share/waydroid-extra/icons");
+    void ListDirectory(const fs::path &dir, DirRecord &record)
+    {
+        std::map<std::string, FileRecord> files;
+        std::error_code ec;
+        for (fs::directory_iterator it(dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+        {
+            if (it->path().extension() != ".desktop")
+                continue;
 
-        return paths;
+            std::string filename = it->path().filename().string();
+            int64_t mtime = 0, size = 0;
+            if (!GetFileStamp(it->path().string(), mtime, size))
+                continue;
+
+            auto known = record.files.find(filename);
+            if (known != record.files.end() && known->second.mtime == mtime && known->second.size == size)
+            {
+                files.emplace(filename, std::move(known->second));
+                reused++;
+            }
+            else
+            {
+                files.emplace(filename, ParseRecord(it->path(), mtime, size));
+                parsed++;
+            }
+        }
+        record.files = std::move(files);
+        dirty = true;
     }
 
-    static std::vector<std::string> GetIconSizes()
+    static void WriteString(std::string &out, const std::string &value)
     {
-        // Add more sizes that Android apps might use
-        return {"128x128", "256x256", "192x192", "144x144", "96x96", "72x72", "scalable", "64x64", "48x48"};
+        uint32_t length = value.size();
+        out.append((const char *)&length, sizeof(length));
+        out += value;
     }
 
-    // Helper function to check if this is a Waydroid app
-    static bool IsWaydroidApp(const std::string &iconName)
+    template <typename T>
+    static void WriteValue(std::string &out, T value)
     {
-        return iconName.find("waydroid") != std::string::npos ||
-               iconName.find("android") != std::string::npos ||
-               iconName.find("org.") == 0 || // Android package names often start with org.
-               iconName.find("com.") == 0;   // or com.
+        out.append((const char *)&value, sizeof(value));
     }
 
-public:
-    static std::string FindIcon(const std::string &iconName)
+    // Bounds-checked reader over the index file contents
+    struct Reader
     {
-        // Debug output
-        std::cout << "Looking for icon: " << iconName << std::endl;
+        const std::string &data;
+        size_t pos = 0;
+        bool ok = true;
 
-        // If it's already a full path
-        if (iconName[0] == '/' && fs::exists(iconName))
+        template <typename T>
+        T Value()
         {
-            std::cout << "Found icon at full path: " << iconName << std::endl;
-            return iconName;
+            T value = {};
+            if (pos + sizeof(T) > data.size())
+            {
+                ok = false;
+                return value;
+            }
+            memcpy(&value, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
         }
 
-        // If it's a relative path starting with ~
-        if (iconName[0] == '~')
+        std::string String()
         {
-            std::string home = getenv("HOME") ? getenv("HOME") : "";
-            if (!home.empty())
+            uint32_t length = Value<uint32_t>();
+            if (!ok || pos + length > data.size())
             {
-                std::string expandedPath = home + iconName.substr(1);
-                if (fs::exists(expandedPath))
-                {
-                    std::cout << "Found icon at expanded path: " << expandedPath << std::endl;
-                    return expandedPath;
-                }
+                ok = false;
+                return "";
             }
+            pos += length;
+            return data.substr(pos - length, length);
         }
+    };
 
-        std::vector<std::string> extensions = {".png", ".jpg", ".jpeg", ".svg", ".xpm", ""};
-        bool isWaydroid = IsWaydroidApp(iconName);
+    void Load()
+    {
+        std::ifstream file(indexPath, std::ios::binary);
+        if (!file.is_open())
+            return;
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
-        for (const auto &basePath : GetIconSearchPaths())
-        {
-            // Skip if path doesn't exist
-            if (!fs::exists(basePath))
-                continue;
+        if (data.size() < sizeof(MAGIC) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+            return;
 
-            // Direct pixmaps search
-            if (basePath.find("pixmaps") != std::string::npos)
+        Reader in{data, sizeof(MAGIC)};
+        if (in.Value<uint32_t>() != VERSION || in.String() != GetEnvironmentKey())
+            return;
+        written = in.Value<int64_t>();
+
+        uint32_t dirCount = in.Value<uint32_t>();
+        for (uint32_t d = 0; d < dirCount && in.ok; d++)
+        {
+            std::string path = in.String();
+            DirRecord &dir = dirs[path];
+            dir.mtime = in.Value<int64_t>();
+            uint32_t fileCount = in.Value<uint32_t>();
+            for (uint32_t f = 0; f < fileCount && in.ok; f++)
             {
-                for (const auto &ext : extensions)
-                {
-                    std::string path = basePath + "/" + iconName + ext;
-                    if (fs::exists(path))
-                    {
-                        std::cout << "Found icon at: " << path << std::endl;
-                        return path;
-                    }
-                }
+                std::string filename = in.String();
+                FileRecord &record = dir.files[filename];
+                record.mtime = in.Value<int64_t>();
+                record.size = in.Value<int64_t>();
+                record.visible = in.Value<uint8_t>() != 0;
+                record.name = in.String();
+                record.exec = in.String();
+                record.icon = in.String();
+                record.tryExec = in.String();
+            }
+        }
+
+        if (!in.ok)
+        {
+            std::cout << "Ignoring damaged desktop entry index: " << indexPath << std::endl;
+            dirs.clear();
+        }
+    }
+
+public:
+    DesktopIndex()
+    {
+        indexPath = GetCacheDirectory();
+        if (!indexPath.empty())
+        {
+            indexPath += "/launcher-apps.bin";
+            Load();
+        }
+    }
+
+    // Appends the visible entries of one directory to apps
+    void Scan(const fs::path &dir, std::vector<std::unique_ptr<AppEntry>> &apps)
+    {
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        {
+            if (dirs.erase(dir.string()))
+                dirty = true;
+            return;
+        }
+        int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+        // An mtime close to the index write may hide a later addition
+        auto known = dirs.find(dir.string());
+        bool unchanged = known != dirs.end() && known->second.mtime == mtime && mtime < written - MTIME_SLACK_NS;
+        DirRecord &record = dirs[dir.string()];
+
+        // Files added, removed or renamed change the directory's mtime
+        if (!unchanged || !RefreshKnownFiles(dir, record))
+        {
+            ListDirectory(dir, record);
+            record.mtime = mtime;
+        }
+
+        for (const auto &[filename, file] : record.files)
+        {
+            // Programs come and go without touching the desktop file
+            if (!file.visible || (!file.tryExec.empty() && !DesktopFileParser::IsExecutableAvailable(file.tryExec)))
+                continue;
+
+            auto app = std::make_unique<AppEntry>();
+            app->name = file.name;
+            app->exec = file.exec;
+            app->icon = file.icon;
+            app->desktopFile = (dir / filename).string();
+            apps.push_back(std::move(app));
+        }
+    }
+
+    // Writes the index back if anything was parsed or dropped, and reports
+    void Save()
+    {
+        std::cout << "Desktop entries: " << reused << " from index, " << parsed << " parsed" << std::endl;
+        reused = 0;
+        parsed = 0;
+        if (!dirty || indexPath.empty())
+            return;
+        dirty = false;
+
+        std::string out(MAGIC, sizeof(MAGIC));
+        WriteValue<uint32_t>(out, VERSION);
+        WriteString(out, GetEnvironmentKey());
+        WriteValue<int64_t>(out, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count());
+        WriteValue<uint32_t>(out, dirs.size());
+        for (const auto &[path, dir] : dirs)
+        {
+            WriteString(out, path);
+            WriteValue<int64_t>(out, dir.mtime);
+            WriteValue<uint32_t>(out, dir.files.size());
+            for (const auto &[filename, record] : dir.files)
+            {
+                WriteString(out, filename);
+                WriteValue<int64_t>(out, record.mtime);
+                WriteValue<int64_t>(out, record.size);
+                WriteValue<uint8_t>(out, record.visible ? 1 : 0);
+                WriteString(out, record.name);
+                WriteString(out, record.exec);
+                WriteString(out, record.icon);
+                WriteString(out, record.tryExec);
+            }
+        }
+
+        std::error_code ec;
+        fs::create_directories(fs::path(indexPath).parent_path(), ec);
+        std::string tempPath = indexPath + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), out.size());
+        file.close();
+
+        if (!file)
+        {
+            std::cerr << "Failed to write desktop entry index: " << tempPath << std::endl;
+            fs::remove(tempPath, ec);
+            return;
+        }
+        fs::rename(tempPath, indexPath, ec);
+        if (ec)
+        {
+            std::cerr << "Failed to replace desktop entry index: " << ec.message() << std::endl;
+            fs::remove(tempPath, ec);
+        }
+    }
+};
+
+class IconLoader
+{
+private:
+    static std::vector<std::string> GetIconSearchPaths()
+    {
+        std::vector<std::string> paths = {
+            "/usr/share/icons/hicolor",
+            "/usr/share/icons/gnome",
+            "/usr/share/icons/Adwaita",
+            "/usr/share/pixmaps"};
+
+        // Add Waydroid-specific paths
+        std::string home = getenv("HOME") ? getenv("HOME") : "";
+        if (!home.empty())
+        {
+            // Waydroid typically stores icons in these locations
+            paths.push_back(home + "/.local/share/icons/hicolor");
+            paths.push_back(home + "/.local/share/icons");
+            paths.push_back(home + "/.local/share/pixmaps");
+            paths.push_back(home + "/.local/share/waydroid-extra/icons");
+
+            // Check for Waydroid data directory
+            std::string waydroidData = home + "/.local/share/waydroid/data";
+            if (fs::exists(waydroidData))
+            {
+                paths.push_back(waydroidData + "/icons");
+            }
+        }
+
+        // Also check system-wide Waydroid locations
+        paths.push_back("/var/lib/waydroid/images/icons");
+        paths.push_back("/usr/share/waydroid-extra/icons");
+
+        return paths;
+    }
+
+    static std::vector<std::string> GetIconSizes()
+    {
+        // Add more sizes that Android apps might use
+        return {"128x128", "256x256", "192x192", "144x144", "96x96", "72x72", "scalable", "64x64", "48x48"};
+    }
+
+    static std::vector<std::string> GetIconExtensions()
+    {
+        return {".png", ".jpg", ".jpeg", ".svg", ".xpm", ""};
+    }
+
+    // Helper function to check if this is a Waydroid app
+    static bool IsWaydroidApp(const std::string &iconName)
+    {
+        return iconName.find("waydroid") != std::string::npos ||
+               iconName.find("android") != std::string::npos ||
+               iconName.find("org.") == 0 || // Android package names often start with org.
+               iconName.find("com.") == 0;   // or com.
+    }
+
+    // Every icon file under the search paths, keyed by the name a desktop
+    // entry would use. The rank packs (search path, size, subdir, extension)
+    // so a lower value is the file the old fs::exists probing found first.
+    struct IconIndex
+    {
+        std::unordered_map<std::string, std::pair<int, std::string>> byName;
+        std::unordered_map<std::string, std::pair<int, std::string>> pixmapsByName;
+        size_t files = 0;
+    };
+
+    static void AddToIndex(std::unordered_map<std::string, std::pair<int, std::string>> &map,
+                           const std::string &name, int rank, const std::string &path)
+    {
+        auto it = map.find(name);
+        if (it == map.end())
+        {
+            map.emplace(name, std::make_pair(rank, path));
+        }
+        else if (rank < it->second.first)
+        {
+            it->second = {rank, path};
+        }
+    }
+
+    static void ScanIconDirectory(IconIndex &index, const std::string &dirPath, int baseRank, bool isPixmaps)
+    {
+        static const std::vector<std::string> extensions = GetIconExtensions();
+
+        std::error_code ec;
+        fs::directory_iterator it(dirPath, ec);
+        if (ec)
+            return;
+
+        for (; it != fs::directory_iterator(); it.increment(ec))
+        {
+            // directory_entry caches d_type, so this does not stat
+            if (it->is_directory(ec))
+                continue;
 
-                // For Waydroid apps, also try without the full package name
-                if (isWaydroid && iconName.find('.') != std::string::npos)
+            std::string filename = it->path().filename().string();
+            std::string extension = it->path().extension().string();
+            index.files++;
+
+            // A bare name matches "Icon=foo.png" style entries (the "" extension)
+            int bareRank = baseRank + (int)extensions.size() - 1;
+            AddToIndex(index.byName, filename, bareRank, it->path().string());
+            if (isPixmaps)
+                AddToIndex(index.pixmapsByName, filename, bareRank, it->path().string());
+
+            for (size_t e = 0; e + 1 < extensions.size(); e++)
+            {
+                if (extension == extensions[e])
                 {
-                    std::string shortName = iconName.substr(iconName.rfind('.') + 1);
-                    for (const auto &ext : extensions)
-                    {
-                        std::string path = basePath + "/" + shortName + ext;
-                        if (fs::exists(path))
-                        {
-                            std::cout << "Found icon with short name at: " << path << std::endl;
-                            return path;
-                        }
-                    }
+                    std::string stem = it->path().stem().string();
+                    AddToIndex(index.byName, stem, baseRank + (int)e, it->path().string());
+                    if (isPixmaps)
+                        AddToIndex(index.pixmapsByName, stem, baseRank + (int)e, it->path().string());
+                    break;
                 }
-                continue;
             }
+        }
+    }
+
+    static IconIndex BuildIndex()
+    {
+        IconIndex index;
+        std::vector<std::string> paths = GetIconSearchPaths();
+        std::vector<std::string> sizes = GetIconSizes();
+        std::vector<std::string> subdirs = {"apps", "applications", ""};
 
-            // Themed icon search
-            for (const auto &size : GetIconSizes())
+        for (size_t p = 0; p < paths.size(); p++)
+        {
+            const std::string &basePath = paths[p];
+            if (basePath.find("pixmaps") != std::string::npos)
             {
-                // Try multiple subdirectories
-                std::vector<std::string> subdirs = {"apps", "applications", ""};
+                ScanIconDirectory(index, basePath, (int)p << 12, true);
+                continue;
+            }
 
-                for (const auto &subdir : subdirs)
+            for (size_t s = 0; s < sizes.size(); s++)
+            {
+                for (size_t d = 0; d < subdirs.size(); d++)
                 {
-                    std::string dirPath = basePath + "/" + size;
-                    if (!subdir.empty())
+                    std::string dirPath = basePath + "/" + sizes[s];
+                    if (!subdirs[d].empty())
                     {
-                        dirPath += "/" + subdir;
+                        dirPath += "/" + subdirs[d];
                     }
+                    ScanIconDirectory(index, dirPath, ((int)p << 12) | ((int)s << 6) | ((int)d << 3), false);
+                }
+            }
+        }
 
-                    for (const auto &ext : extensions)
-                    {
-                        std::string path = dirPath + "/" + iconName + ext;
-                        if (fs::exists(path))
-                        {
-                            std::cout << "Found icon at: " << path << std::endl;
-                            return path;
-                        }
-                    }
+        return index;
+    }
+
+    static inline std::mutex indexMutex;
+    static inline std::shared_ptr<const IconIndex> currentIndex;
+
+    static std::shared_ptr<const IconIndex> GetIndex()
+    {
+        // Built on first use; the scan replaces thousands of stat calls per lookup
+        std::lock_guard<std::mutex> lock(indexMutex);
+        if (!currentIndex)
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto built = std::make_shared<IconIndex>(BuildIndex());
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Indexed " << built->files << " icon files (" << built->byName.size() << " names) in " << ms << " ms" << std::endl;
+            currentIndex = built;
+        }
+        return currentIndex;
+    }
+
+public:
+    // Newly installed apps usually bring new icons; rescan on the next lookup
+    static void InvalidateIndex()
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        currentIndex.reset();
+    }
+
+    static std::string FindIcon(const std::string &iconName)
+    {
+        // Debug output
+        std::cout << "Looking for icon: " << iconName << std::endl;
+
+        // If it's already a full path
+        if (iconName[0] == '/' && fs::exists(iconName))
+        {
+            std::cout << "Found icon at full path: " << iconName << std::endl;
+            return iconName;
+        }
+
+        // If it's a relative path starting with ~
+        if (iconName[0] == '~')
+        {
+            std::string home = getenv("HOME") ? getenv("HOME") : "";
+            if (!home.empty())
+            {
+                std::string expandedPath = home + iconName.substr(1);
+                if (fs::exists(expandedPath))
+                {
+                    std::cout << "Found icon at expanded path: " << expandedPath << std::endl;
+                    return expandedPath;
                 }
             }
         }
 
+        std::shared_ptr<const IconIndex> indexRef = GetIndex();
+        const IconIndex &index = *indexRef;
+        bool isWaydroid = IsWaydroidApp(iconName);
+        const std::pair<int, std::string> *best = nullptr;
+
+        auto found = index.byName.find(iconName);
+        if (found != index.byName.end())
+        {
+            best = &found->second;
+        }
+
+        // For Waydroid apps, pixmaps directories also match the name without
+        // the package prefix, ranked just after the full name in that directory
+        if (isWaydroid && iconName.find('.') != std::string::npos)
+        {
+            std::string shortName = iconName.substr(iconName.rfind('.') + 1);
+            auto shortFound = index.pixmapsByName.find(shortName);
+            if (shortFound != index.pixmapsByName.end() &&
+                (!best || (shortFound->second.first | 0x800) < best->first))
+            {
+                std::cout << "Found icon with short name at: " << shortFound->second.second << std::endl;
+                return shortFound->second.second;
+            }
+        }
+
+        if (best)
+        {
+            std::cout << "Found icon at: " << best->second << std::endl;
+            return best->second;
+        }
+
         // Special handling for Waydroid apps - try to find Android APK icons
         if (isWaydroid)
         {
@@ -426,69 +1171,1137 @@ public:
                 std::string overlayPath = home + "/.local/share/waydroid/overlay";
                 if (fs::exists(overlayPath))
                 {
-                    // This would need more complex logic to extract from APKs
-                    std::cout << "Could check Waydroid overlay at: " << overlayPath << std::endl;
+                    // This would need more complex logic to extract from APKs
+                    std::cout << "Could check Waydroid overlay at: " << overlayPath << std::endl;
+                }
+            }
+        }
+
+        std::cout << "Icon not found for: " << iconName << std::endl;
+        return "";
+    }
+
+    // Decodes an icon and letterboxes it into an ICON_SIZE x ICON_SIZE RGBA
+    // image. Returns false for SVGs and unreadable files.
+    static bool TryDecodeIcon(const std::string &iconPath, Image &img)
+    {
+        if (iconPath.empty())
+        {
+            return false; // No icon path, skip this app
+        }
+
+        // Load image based on extension
+        if (hasEnding(iconPath, ".svg"))
+        {
+            // SVG files not supported without additional library
+            return false;
+        }
+
+        img = LoadImage(iconPath.c_str());
+        if (!img.data)
+        {
+            return false; // Failed to load image
+        }
+
+        // Resize to standard icon size while maintaining aspect ratio
+        float scale = std::min((float)ICON_SIZE / img.width, (float)ICON_SIZE / img.height);
+        int newWidth = img.width * scale;
+        int newHeight = img.height * scale;
+
+        ImageResize(&img, newWidth, newHeight);
+
+        // Create a new image with padding if needed
+        if (newWidth < ICON_SIZE || newHeight < ICON_SIZE)
+        {
+            Image paddedImg = GenImageColor(ICON_SIZE, ICON_SIZE, BLANK);
+            int offsetX = (ICON_SIZE - newWidth) / 2;
+            int offsetY = (ICON_SIZE - newHeight) / 2;
+            ImageDraw(&paddedImg, img,
+                      (Rectangle){0, 0, (float)newWidth, (float)newHeight},
+                      (Rectangle){(float)offsetX, (float)offsetY, (float)newWidth, (float)newHeight},
+                      WHITE);
+            UnloadImage(img);
+            img = paddedImg;
+        }
+
+        // The cache and the atlas both expect tightly packed RGBA
+        ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        return true;
+    }
+};
+
+// Decoded, letterboxed icons from previous runs, stored as raw RGBA in one
+// file that is mapped at startup. An entry is reused only while its source
+// file keeps the same mtime and size; anything not looked up during a run is
+// dropped when the file is rewritten. Icons found between passes go to a small
+// journal instead, which the next rewrite folds in.
+class IconCache
+{
+private:
+    static constexpr char MAGIC[8] = {'D', 'N', 'D', 'Y', 'I', 'C', 'O', 'N'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t ICON_BYTES = (size_t)ICON_SIZE * ICON_SIZE * 4;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t iconSize;
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    struct Record
+    {
+        int64_t mtime;
+        int64_t size;
+        uint64_t pixelOffset;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    // Journal layout: a Header, then per icon a JournalRecord, the path and
+    // ICON_BYTES of pixels
+    struct JournalRecord
+    {
+        int64_t mtime;
+        int64_t size;
+        uint32_t pathLength;
+        uint32_t reserved;
+    };
+
+    struct Entry
+    {
+        int64_t mtime;
+        int64_t size;
+        const unsigned char *pixels; // Into the mapping or into owned
+        std::shared_ptr<const std::vector<unsigned char>> owned; // Shared with a Save in progress
+        bool used;
+    };
+
+    // An entry as Save found it, written out without holding the lock
+    struct SavedEntry
+    {
+        std::string path;
+        int64_t mtime;
+        int64_t size;
+        const unsigned char *pixels;
+        std::shared_ptr<const std::vector<unsigned char>> owned;
+    };
+
+    std::string cachePath;
+    std::string journalPath;
+    void *mapping = MAP_FAILED;
+    size_t mappingSize = 0;
+    std::unordered_map<std::string, Entry> entries;
+    std::vector<std::string> unjournaled; // Stored since the file or journal was last written
+    bool dirty = false; // The cache file lacks something in entries
+    int hits = 0;
+    int misses = 0;
+    std::mutex mutex; // Find and Store are called from the icon workers
+    std::mutex saveMutex; // One writer at a time, without blocking mutex
+
+    void Map()
+    {
+        int fd = open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header))
+        {
+            mappingSize = st.st_size;
+            mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+            return;
+
+        const unsigned char *base = (const unsigned char *)mapping;
+        Header header;
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+            header.iconSize != (uint32_t)ICON_SIZE ||
+            sizeof(Header) + (size_t)header.count * sizeof(Record) > mappingSize)
+        {
+            std::cout << "Ignoring icon cache with a different format: " << cachePath << std::endl;
+            return;
+        }
+
+        const Record *records = (const Record *)(base + sizeof(Header));
+        for (uint32_t i = 0; i < header.count; i++)
+        {
+            const Record &r = records[i];
+            if ((size_t)r.pathOffset + r.pathLength > mappingSize ||
+                r.pixelOffset > mappingSize || mappingSize - r.pixelOffset < ICON_BYTES)
+            {
+                std::cout << "Ignoring truncated icon cache: " << cachePath << std::endl;
+                entries.clear();
+                return;
+            }
+
+            Entry entry{r.mtime, r.size, base + r.pixelOffset, {}, false};
+            entries.emplace(std::string((const char *)base + r.pathOffset, r.pathLength), std::move(entry));
+        }
+
+        // A read-ahead of the whole file beats faulting in one icon at a time
+        madvise(mapping, mappingSize, MADV_WILLNEED);
+    }
+
+    void ReadJournal()
+    {
+        std::ifstream in(journalPath, std::ios::binary);
+        if (!in)
+            return;
+
+        Header header;
+        if (!in.read((char *)&header, sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header.version != VERSION || header.iconSize != (uint32_t)ICON_SIZE)
+        {
+            std::error_code ec;
+            fs::remove(journalPath, ec);
+            return;
+        }
+
+        // A record cut short by a crash ends the journal
+        JournalRecord r;
+        std::string path;
+        while (in.read((char *)&r, sizeof(r)) && r.pathLength <= PATH_MAX)
+        {
+            path.resize(r.pathLength);
+            auto pixels = std::make_shared<std::vector<unsigned char>>(ICON_BYTES);
+            if (!in.read(path.data(), path.size()) || !in.read((char *)pixels->data(), ICON_BYTES))
+                break;
+            entries[path] = Entry{r.mtime, r.size, pixels->data(), pixels, false};
+            dirty = true;
+        }
+    }
+
+    // Adds icons stored since the last write to the journal
+    void AppendJournal(const std::vector<SavedEntry> &added)
+    {
+        std::error_code ec;
+        fs::create_directories(fs::path(journalPath).parent_path(), ec);
+        bool fresh = fs::file_size(journalPath, ec) == 0 || ec;
+        std::ofstream out(journalPath, std::ios::binary | std::ios::app);
+        if (fresh)
+        {
+            Header header = {};
+            memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.iconSize = ICON_SIZE;
+            out.write((const char *)&header, sizeof(header));
+        }
+
+        for (const SavedEntry &entry : added)
+        {
+            JournalRecord r = {entry.mtime, entry.size, (uint32_t)entry.path.size(), 0};
+            out.write((const char *)&r, sizeof(r));
+            out.write(entry.path.data(), entry.path.size());
+            out.write((const char *)entry.pixels, ICON_BYTES);
+        }
+        out.close();
+
+        if (!out)
+        {
+            std::cerr << "Failed to append to icon cache journal: " << journalPath << std::endl;
+            return;
+        }
+        std::cout << "Added " << added.size() << " icons to the icon cache journal" << std::endl;
+    }
+
+    // After a failed rewrite, so the next pass tries again
+    void MarkDirty()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dirty = true;
+    }
+
+public:
+    IconCache() : cachePath(GetCacheDirectory())
+    {
+        if (!cachePath.empty())
+        {
+            journalPath = cachePath + "/launcher-icons.journal";
+            cachePath += "/launcher-icons.bin";
+            Map();
+            ReadJournal();
+        }
+    }
+
+    ~IconCache()
+    {
+        if (mapping != MAP_FAILED)
+        {
+            munmap(mapping, mappingSize);
+        }
+    }
+
+    IconCache(const IconCache &) = delete;
+    IconCache &operator=(const IconCache &) = delete;
+
+    // Returns ICON_BYTES of RGBA for a fresh entry, or nullptr. The pointer
+    // stays valid for the lifetime of the cache.
+    const unsigned char *Find(const std::string &path, int64_t mtime, int64_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(path);
+        if (it == entries.end() || it->second.mtime != mtime || it->second.size != size)
+        {
+            misses++;
+            return nullptr;
+        }
+
+        hits++;
+        it->second.used = true;
+        return it->second.pixels;
+    }
+
+    void Store(const std::string &path, int64_t mtime, int64_t size, const void *pixels)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = entries[path];
+        entry.mtime = mtime;
+        entry.size = size;
+        auto owned = std::make_shared<const std::vector<unsigned char>>((const unsigned char *)pixels,
+                                                                       (const unsigned char *)pixels + ICON_BYTES);
+        entry.pixels = owned->data();
+        entry.owned = std::move(owned);
+        entry.used = true;
+        dirty = true;
+        unjournaled.push_back(path);
+    }
+
+    // Starts a pass over every app: only what it looks up survives the next
+    // pruning Save
+    void BeginPass()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &[path, entry] : entries)
+        {
+            entry.used = false;
+        }
+    }
+
+    // After a pass over every app, rewrites the cache file if anything was
+    // added or replaced, dropping the entries nobody asked for. Otherwise only
+    // appends the new icons to the journal. The entries are copied out under
+    // the lock and written without it, so Find, Store and BeginPass never wait
+    // on the disk.
+    void Save(bool prune)
+    {
+        std::lock_guard<std::mutex> saving(saveMutex);
+        std::vector<SavedEntry> live;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::cout << "Icon cache: " << hits << " hits, " << misses << " misses" << std::endl;
+            if (cachePath.empty())
+                return;
+
+            if (!prune)
+            {
+                for (const std::string &path : unjournaled)
+                {
+                    const Entry &entry = entries.at(path);
+                    live.push_back({path, entry.mtime, entry.size, entry.pixels, entry.owned});
+                }
+                unjournaled.clear();
+            }
+            else
+            {
+                size_t used = 0;
+                for (const auto &[path, entry] : entries)
+                {
+                    if (entry.used)
+                        used++;
+                }
+                if (!dirty && used == entries.size())
+                    return;
+                dirty = false;
+                unjournaled.clear(); // The rewrite covers them
+
+                for (const auto &[path, entry] : entries)
+                {
+                    if (entry.used)
+                        live.push_back({path, entry.mtime, entry.size, entry.pixels, entry.owned});
+                }
+            }
+        }
+
+        if (!prune)
+        {
+            if (!live.empty())
+                AppendJournal(live);
+            return;
+        }
+
+        size_t stringBytes = 0;
+        for (const SavedEntry &entry : live)
+        {
+            stringBytes += entry.path.size();
+        }
+
+        // The pixel area starts on a page boundary, apart from the index pages;
+        // the blocks inside it are packed back to back, ICON_BYTES apart
+        size_t pixelStart = sizeof(Header) + live.size() * sizeof(Record) + stringBytes;
+        pixelStart = (pixelStart + 4095) & ~(size_t)4095;
+
+        Header header = {};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.iconSize = ICON_SIZE;
+        header.count = live.size();
+
+        std::vector<Record> records;
+        std::string strings;
+        for (size_t i = 0; i < live.size(); i++)
+        {
+            Record r = {};
+            r.mtime = live[i].mtime;
+            r.size = live[i].size;
+            r.pixelOffset = pixelStart + i * ICON_BYTES;
+            r.pathOffset = sizeof(Header) + live.size() * sizeof(Record) + strings.size();
+            r.pathLength = live[i].path.size();
+            strings += live[i].path;
+            records.push_back(r);
+        }
+        strings.resize(pixelStart - sizeof(Header) - live.size() * sizeof(Record), '\0');
+
+        std::error_code ec;
+        fs::create_directories(fs::path(cachePath).parent_path(), ec);
+        std::string tempPath = cachePath + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)records.data(), records.size() * sizeof(Record));
+        out.write(strings.data(), strings.size());
+        for (const SavedEntry &entry : live)
+        {
+            out.write((const char *)entry.pixels, ICON_BYTES);
+        }
+        out.close();
+
+        if (!out)
+        {
+            std::cerr << "Failed to write icon cache: " << tempPath << std::endl;
+            fs::remove(tempPath, ec);
+            MarkDirty();
+            return;
+        }
+
+        // Rename over the old file; the current mapping stays valid until unmapped
+        fs::rename(tempPath, cachePath, ec);
+        if (ec)
+        {
+            std::cerr << "Failed to replace icon cache: " << ec.message() << std::endl;
+            fs::remove(tempPath, ec);
+            MarkDirty();
+            return;
+        }
+        fs::remove(journalPath, ec); // Folded into the new file
+        std::cout << "Wrote icon cache with " << live.size() << " icons ("
+                  << (pixelStart + live.size() * ICON_BYTES) / (1024 * 1024) << " MB)" << std::endl;
+    }
+};
+
+// Icons packed into a few large textures so the grid draws as one batch per
+// page instead of one texture bind per tile. Each slot has a one pixel
+// border copied from the icon's edge so bilinear filtering never picks up a
+// neighbouring icon.
+class IconAtlas
+{
+private:
+    static constexpr int MAX_PAGE_SIZE = 2048;
+    static constexpr int SLOT_SIZE = ICON_SIZE + 2;
+    static constexpr int SLOTS_PER_ROW = MAX_PAGE_SIZE / SLOT_SIZE;
+    static constexpr int PAGE_WIDTH = SLOTS_PER_ROW * SLOT_SIZE;
+
+    std::vector<Texture2D> pages;
+    int pageCapacity = 0; // Slots in the newest page
+    int pageUsed = 0;
+    int expectedSlots = 0;
+    std::vector<std::pair<int, Rectangle>> freeSlots; // Page index and slot, bordered
+    std::vector<unsigned char> slotPixels = std::vector<unsigned char>((size_t)SLOT_SIZE * SLOT_SIZE * 4);
+
+public:
+    IconAtlas() = default;
+    IconAtlas(const IconAtlas &) = delete;
+    IconAtlas &operator=(const IconAtlas &) = delete;
+
+    ~IconAtlas()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        for (const Texture2D &page : pages)
+        {
+            UnloadTexture(page);
+        }
+        pages.clear();
+        freeSlots.clear();
+        pageCapacity = 0;
+        pageUsed = 0;
+    }
+
+    // Lets the last page be only as tall as the remaining icons need
+    void Reserve(int count)
+    {
+        expectedSlots = count;
+    }
+
+    // Copies an ICON_SIZE x ICON_SIZE RGBA icon into the next free slot
+    void Add(const unsigned char *pixels, Texture2D &page, Rectangle &rect)
+    {
+        int pageIndex = (int)pages.size() - 1;
+        float slotX, slotY;
+        if (!freeSlots.empty())
+        {
+            pageIndex = freeSlots.back().first;
+            slotX = freeSlots.back().second.x;
+            slotY = freeSlots.back().second.y;
+            freeSlots.pop_back();
+        }
+        else
+        {
+            if (pageUsed == pageCapacity)
+            {
+                // Without a reservation (live additions) grow page heights geometrically
+                int lastRows = pages.empty() ? SLOTS_PER_ROW : pages.back().height / SLOT_SIZE;
+                int minRows = lastRows < SLOTS_PER_ROW ? lastRows * 2 : 1;
+                int rows = std::clamp(std::max((expectedSlots + SLOTS_PER_ROW - 1) / SLOTS_PER_ROW, minRows), 1, SLOTS_PER_ROW);
+                // Allocate without uploading; only filled slots are ever sampled
+                Texture2D texture = {};
+                texture.width = PAGE_WIDTH;
+                texture.height = rows * SLOT_SIZE;
+                texture.mipmaps = 1;
+                texture.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+                texture.id = rlLoadTexture(nullptr, texture.width, texture.height, texture.format, 1);
+                SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+                pages.push_back(texture);
+                pageCapacity = rows * SLOTS_PER_ROW;
+                pageUsed = 0;
+                pageIndex = (int)pages.size() - 1;
+            }
+            int slot = pageUsed++;
+            expectedSlots = std::max(0, expectedSlots - 1);
+            slotX = (float)(slot % SLOTS_PER_ROW) * SLOT_SIZE;
+            slotY = (float)(slot / SLOTS_PER_ROW) * SLOT_SIZE;
+        }
+
+        // Build the bordered slot: the icon at (1,1), edges extruded by one pixel
+        const size_t rowBytes = (size_t)ICON_SIZE * 4;
+        const size_t slotRowBytes = (size_t)SLOT_SIZE * 4;
+        for (int y = 0; y < SLOT_SIZE; y++)
+        {
+            int srcY = std::clamp(y - 1, 0, ICON_SIZE - 1);
+            const unsigned char *src = pixels + srcY * rowBytes;
+            unsigned char *dst = slotPixels.data() + y * slotRowBytes;
+            memcpy(dst + 4, src, rowBytes);
+            memcpy(dst, src, 4);
+            memcpy(dst + slotRowBytes - 4, src + rowBytes - 4, 4);
+        }
+
+        UpdateTextureRec(pages[pageIndex], {slotX, slotY, (float)SLOT_SIZE, (float)SLOT_SIZE}, slotPixels.data());
+
+        page = pages[pageIndex];
+        rect = {slotX + 1, slotY + 1, (float)ICON_SIZE, (float)ICON_SIZE};
+    }
+
+    // Returns an icon's slot for reuse by the next Add
+    void Release(const Texture2D &page, const Rectangle &rect)
+    {
+        for (int i = 0; i < (int)pages.size(); i++)
+        {
+            if (pages[i].id == page.id)
+            {
+                freeSlots.push_back({i, {rect.x - 1, rect.y - 1, (float)SLOT_SIZE, (float)SLOT_SIZE}});
+                return;
+            }
+        }
+    }
+
+    int PageCount() const
+    {
+        return (int)pages.size();
+    }
+};
+
+// Pre-renders tile names, shadow included, into shared render textures so a
+// label costs one quad per frame rather than two glyph quads per character.
+// Labels are packed left to right in rows of one line height; removed labels
+// leave holes until the next Rebuild. The text is black, so a page only holds
+// coverage in a single channel and labels are drawn by darkening what is
+// behind them.
+class LabelAtlas
+{
+private:
+    static constexpr int PAGE_SIZE = 2048;
+    static constexpr int MAX_WIDTH = CELL_WIDTH - 2; // Longer names are cut at the tile's edge
+    static constexpr float FONT_SIZE = 32;
+    static constexpr float SPACING = 1;
+
+    std::vector<RenderTexture2D> pages;
+    std::vector<int> pageRows; // Row capacity of each page, allocated or not
+    int rowHeight = 0;
+    int cursorX = 0; // Next free spot in the newest page
+    int cursorRow = 0;
+    long liveArea = 0;
+    long deadArea = 0;
+
+    struct Placement
+    {
+        AppEntry *app;
+        int page;
+        int x;
+        int y;
+        Vector2 size;
+        bool clipped;
+    };
+
+    // Finds room for a label, opening a page of the given rows when needed
+    void Place(Placement &label, int newPageRows)
+    {
+        label.clipped = label.size.x > MAX_WIDTH;
+        label.size.x = std::min(label.size.x, (float)MAX_WIDTH);
+        int width = (int)std::ceil(label.size.x) + 2; // Shadow and a gap
+        if (!pageRows.empty() && cursorX + width > PAGE_SIZE)
+        {
+            cursorRow++;
+            cursorX = 0;
+        }
+        if (pageRows.empty() || cursorRow >= pageRows.back())
+        {
+            pageRows.push_back(newPageRows);
+            cursorRow = 0;
+            cursorX = 0;
+        }
+        label.page = (int)pageRows.size() - 1;
+        label.x = cursorX;
+        label.y = cursorRow * rowHeight;
+        cursorX += width;
+        liveArea += (long)width * rowHeight;
+    }
+
+    // Creates the textures for pages placed but not yet allocated
+    void AllocatePages()
+    {
+        while (pages.size() < pageRows.size())
+        {
+            // A framebuffer without the depth buffer LoadRenderTexture would add
+            RenderTexture2D page = {};
+            page.id = rlLoadFramebuffer();
+            page.texture.width = PAGE_SIZE;
+            page.texture.height = pageRows[pages.size()] * rowHeight;
+            page.texture.mipmaps = 1;
+            page.texture.format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+            page.texture.id = rlLoadTexture(nullptr, page.texture.width, page.texture.height, page.texture.format, 1);
+            rlFramebufferAttach(page.id, page.texture.id, RL_ATTACHMENT_COLOR_CHANNEL0, RL_ATTACHMENT_TEXTURE2D, 0);
+            if (!rlFramebufferComplete(page.id))
+            {
+                // OpenGL ES 2 can't render to luminance; RGBA holds the same coverage
+                rlUnloadTexture(page.texture.id);
+                page.texture.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+                page.texture.id = rlLoadTexture(nullptr, page.texture.width, page.texture.height, page.texture.format, 1);
+                rlFramebufferAttach(page.id, page.texture.id, RL_ATTACHMENT_COLOR_CHANNEL0, RL_ATTACHMENT_TEXTURE2D, 0);
+                if (!rlFramebufferComplete(page.id))
+                {
+                    std::cerr << "Label atlas framebuffer is incomplete" << std::endl;
+                }
+            }
+
+            BeginTextureMode(page);
+            ClearBackground(BLANK);
+            EndTextureMode();
+            pages.push_back(page);
+        }
+    }
+
+    // Draws labels already placed on one page
+    void Render(const Font &font, int pageIndex, const std::vector<Placement> &labels, size_t from, size_t to)
+    {
+        const RenderTexture2D &page = pages[pageIndex];
+        BeginTextureMode(page);
+
+        // White over black leaves the combined coverage of shadow and text in red
+        for (size_t i = from; i < to; i++)
+        {
+            const Placement &label = labels[i];
+            const char *name = label.app->name.c_str();
+            float width = std::ceil(label.size.x) + 1;
+            float height = std::ceil(label.size.y) + 1;
+
+            // Keep a long name out of its neighbour's space
+            if (label.clipped)
+                BeginScissorMode(label.x, label.y, (int)width, rowHeight);
+            DrawTextEx(font, name, {(float)label.x + 1, (float)label.y + 1}, FONT_SIZE, SPACING, Color{255, 255, 255, 32});
+            DrawTextEx(font, name, {(float)label.x, (float)label.y}, FONT_SIZE, SPACING, WHITE);
+            if (label.clipped)
+                EndScissorMode();
+
+            // Render textures are stored bottom-up, so the source rect is flipped
+            label.app->labelAtlas = page.texture;
+            label.app->labelRect = {(float)label.x, page.texture.height - label.y - height, width, -height};
+        }
+        EndTextureMode();
+    }
+
+    int MaxRows() const
+    {
+        return PAGE_SIZE / rowHeight;
+    }
+
+public:
+    LabelAtlas() = default;
+    LabelAtlas(const LabelAtlas &) = delete;
+    LabelAtlas &operator=(const LabelAtlas &) = delete;
+
+    ~LabelAtlas()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        for (const RenderTexture2D &page : pages)
+        {
+            UnloadRenderTexture(page);
+        }
+        pages.clear();
+        pageRows.clear();
+        cursorX = 0;
+        cursorRow = 0;
+        liveArea = 0;
+        deadArea = 0;
+    }
+
+    // Renders every label from scratch, with the last page only as tall as needed
+    void Rebuild(const std::vector<std::unique_ptr<AppEntry>> &apps, const Font &font)
+    {
+        Clear();
+        rowHeight = (int)std::ceil(MeasureTextEx(font, "Ag", FONT_SIZE, SPACING).y) + 2;
+
+        std::vector<Placement> labels(apps.size());
+        for (size_t i = 0; i < apps.size(); i++)
+        {
+            labels[i].app = apps[i].get();
+            labels[i].size = MeasureTextEx(font, apps[i]->name.c_str(), FONT_SIZE, SPACING);
+            Place(labels[i], MaxRows());
+        }
+        if (!pageRows.empty())
+        {
+            pageRows.back() = cursorRow + 1;
+        }
+        AllocatePages();
+
+        // One pass per page
+        size_t from = 0;
+        while (from < labels.size())
+        {
+            size_t to = from;
+            while (to < labels.size() && labels[to].page == labels[from].page)
+            {
+                to++;
+            }
+            Render(font, labels[from].page, labels, from, to);
+            from = to;
+        }
+    }
+
+    // Renders one more label, growing page heights geometrically
+    void Add(AppEntry &app, const Font &font)
+    {
+        if (rowHeight == 0)
+        {
+            rowHeight = (int)std::ceil(MeasureTextEx(font, "Ag", FONT_SIZE, SPACING).y) + 2;
+        }
+
+        int lastRows = pageRows.empty() ? MaxRows() : pageRows.back();
+        int rows = lastRows < MaxRows() ? std::min(lastRows * 2, MaxRows()) : 1;
+
+        std::vector<Placement> label(1);
+        label[0].app = &app;
+        label[0].size = MeasureTextEx(font, app.name.c_str(), FONT_SIZE, SPACING);
+        Place(label[0], rows);
+        AllocatePages();
+        Render(font, label[0].page, label, 0, 1);
+    }
+
+    // Marks a label's space as unused
+    void Release(AppEntry &app)
+    {
+        if (!app.labelAtlas.id)
+            return;
+
+        long area = (long)(app.labelRect.width + 1) * rowHeight;
+        liveArea -= area;
+        deadArea += area;
+        app.labelAtlas = {};
+    }
+
+    // True once holes take up more room than the labels in use
+    bool Fragmented() const
+    {
+        return deadArea > liveArea;
+    }
+
+    int PageCount() const
+    {
+        return (int)pages.size();
+    }
+};
+
+// Resolves, decodes and caches icons on worker threads so the grid can be
+// shown before every icon is ready. Finished icons queue up for the render
+// thread, which owns the GPU and uploads a few per frame.
+class AsyncIconLoader
+{
+public:
+    struct Result
+    {
+        AppEntry *app;
+        std::string desktopFile; // Identifies the app; the pointer may be stale by now
+        std::string icon; // The icon name the job was queued with
+        bool ok;
+        const unsigned char *pixels; // RGBA, either in the cache mapping or in image
+        Image image;
+    };
+
+private:
+    struct Job
+    {
+        AppEntry *app;
+        std::string desktopFile;
+        std::string icon;
+        std::string name;
+        unsigned generation;
+    };
+
+    IconCache cache;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::deque<Result> results;
+    size_t pending = 0;
+    unsigned generation = 0; // Bumped by Cancel; results of older jobs are dropped
+    bool saving = false; // The last worker is writing the cache file
+    bool prune = false;  // A pass over every app is queued
+    bool stopping = false;
+
+    Result Load(const Job &job)
+    {
+        Result result = {job.app, job.desktopFile, job.icon, false, nullptr, {}};
+        std::string iconPath = IconLoader::FindIcon(job.icon);
+
+        int64_t mtime = 0, size = 0;
+        if (iconPath.empty() || !GetFileStamp(iconPath, mtime, size))
+        {
+            std::cout << "No icon found for: " << job.name << " (icon: " << job.icon << ")" << std::endl;
+            return result;
+        }
+
+        // Warm path: upload straight from the mapped cache file
+        result.pixels = cache.Find(iconPath, mtime, size);
+        if (!result.pixels)
+        {
+            if (!IconLoader::TryDecodeIcon(iconPath, result.image))
+            {
+                std::cout << "Failed to load icon texture for: " << job.name << " (path: " << iconPath << ")" << std::endl;
+                return result;
+            }
+            cache.Store(iconPath, mtime, size, result.image.data);
+            result.pixels = (const unsigned char *)result.image.data;
+        }
+
+        result.ok = true;
+        return result;
+    }
+
+    void WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this]
+                      { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            Result result = Load(job);
+
+            lock.lock();
+            if (job.generation == generation)
+                results.push_back(result);
+            else
+                Release(result); // Its app may be gone
+            if (--pending == 0)
+            {
+                // Last icon: persist the cache while the render thread animates
+                bool pass = prune;
+                prune = false;
+                saving = true;
+                lock.unlock();
+                cache.Save(pass);
+                lock.lock();
+                saving = false;
+            }
+        }
+    }
+
+public:
+    AsyncIconLoader()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        int count = std::clamp((int)cores - 1, 1, MAX_ICON_WORKERS);
+        for (int i = 0; i < count; i++)
+        {
+            workers.emplace_back(&AsyncIconLoader::WorkerLoop, this);
+        }
+    }
+
+    ~AsyncIconLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        for (Result &result : results)
+        {
+            Release(result);
+        }
+    }
+
+    AsyncIconLoader(const AsyncIconLoader &) = delete;
+    AsyncIconLoader &operator=(const AsyncIconLoader &) = delete;
+
+    // Jobs run in the order queued, so queue in grid order. Queue a pass over
+    // every app in one call with pass set: once the queue runs dry the cache
+    // keeps only the icons that pass asked for. Other batches only add to it.
+    void Enqueue(const std::vector<AppEntry *> &batch, bool pass)
+    {
+        if (pass)
+            cache.BeginPass();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (AppEntry *app : batch)
+            {
+                jobs.push_back({app, app->desktopFile, app->icon, app->name, generation});
+            }
+            pending += batch.size();
+            prune = prune || pass;
+        }
+        wake.notify_all();
+    }
+
+    // Drops queued jobs and unclaimed results, before the apps they point to go away
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending -= jobs.size();
+        jobs.clear();
+        for (Result &result : results)
+        {
+            Release(result);
+        }
+        results.clear();
+        generation++;
+        prune = false; // A cut-short pass must not prune
+    }
+
+    bool TakeResult(Result &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (results.empty())
+            return false;
+        out = results.front();
+        results.pop_front();
+        return true;
+    }
+
+    // True once every icon has been loaded and handed out and the cache is saved
+    bool Finished()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending == 0 && results.empty() && !saving;
+    }
+
+    static void Release(Result &result)
+    {
+        if (result.image.data)
+        {
+            UnloadImage(result.image);
+            result.image.data = nullptr;
+        }
+    }
+};
+
+// Watches the application directories with inotify on a background thread.
+// Changed .desktop files are parsed there once writes settle, and the render
+// thread picks up the results between frames.
+class ApplicationWatcher
+{
+public:
+    struct Change
+    {
+        std::string desktopFile;
+        std::unique_ptr<AppEntry> entry; // nullptr when removed or now hidden
+    };
+
+private:
+    int inotifyFd = -1;
+    int stopFd = -1;
+    std::map<int, std::string> watchedDirs;
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<Change> changes;
+    bool overflowed = false;
+
+    void ReadEvents(std::set<std::string> &dirtyFiles)
+    {
+        alignas(struct inotify_event) char buffer[16384];
+        while (true)
+        {
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+                return;
+
+            for (char *ptr = buffer; ptr < buffer + length;)
+            {
+                const struct inotify_event *event = (const struct inotify_event *)ptr;
+                ptr += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    overflowed = true;
+                    continue;
+                }
+
+                auto dir = watchedDirs.find(event->wd);
+                if (dir == watchedDirs.end() || event->len == 0)
+                    continue;
+
+                std::string name = event->name;
+                if (hasEnding(name, ".desktop"))
+                {
+                    dirtyFiles.insert(dir->second + "/" + name);
+                }
+            }
+        }
+    }
+
+    void Run()
+    {
+        std::set<std::string> dirtyFiles;
+        while (true)
+        {
+            // Wait for the writer to finish before parsing what it touched
+            pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+            int ready = poll(fds, 2, dirtyFiles.empty() ? -1 : WATCH_SETTLE_MS);
+            if (ready < 0 && errno != EINTR)
+                return;
+            if (fds[1].revents & POLLIN)
+                return;
+
+            if (fds[0].revents & POLLIN)
+            {
+                ReadEvents(dirtyFiles);
+                continue;
+            }
+
+            if (ready == 0 && !dirtyFiles.empty())
+            {
+                std::vector<Change> parsed;
+                for (const std::string &path : dirtyFiles)
+                {
+                    // A missing file parses to nullptr, same as a hidden one
+                    auto entry = DesktopFileParser::ParseFile(path);
+                    if (entry)
+                        entry->desktopFile = path;
+                    parsed.push_back({path, std::move(entry)});
+                }
+                dirtyFiles.clear();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (Change &change : parsed)
+                {
+                    changes.push_back(std::move(change));
                 }
             }
         }
-
-        std::cout << "Icon not found for: " << iconName << std::endl;
-        return "";
     }
 
-    // Returns true if icon was loaded successfully, false otherwise
-    static bool TryLoadIconTexture(const std::string &iconPath, Texture2D &tex)
+public:
+    explicit ApplicationWatcher(const std::vector<std::string> &dirs)
     {
-        if (iconPath.empty())
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (inotifyFd < 0 || stopFd < 0)
         {
-            return false; // No icon path, skip this app
+            std::cerr << "Failed to start application watcher: " << strerror(errno) << std::endl;
+            return;
         }
 
-        // Load image based on extension
-        if (hasEnding(iconPath, ".svg"))
-        {
-            // SVG files not supported without additional library
-            return false;
-        }
-        else
+        const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+        for (const std::string &dir : dirs)
         {
-            Image img = LoadImage(iconPath.c_str());
-            if (img.data)
+            int wd = inotify_add_watch(inotifyFd, dir.c_str(), mask);
+            if (wd >= 0)
             {
-                // Resize to standard icon size while maintaining aspect ratio
-                float scale = std::min((float)ICON_SIZE / img.width, (float)ICON_SIZE / img.height);
-                int newWidth = img.width * scale;
-                int newHeight = img.height * scale;
-
-                ImageResize(&img, newWidth, newHeight);
+                watchedDirs[wd] = dir;
+                std::cout << "Watching " << dir << " for application changes" << std::endl;
+            }
+        }
 
-                // Create a new image with padding if needed
-                if (newWidth < ICON_SIZE || newHeight < ICON_SIZE)
-                {
-                    Image paddedImg = GenImageColor(ICON_SIZE, ICON_SIZE, BLANK);
-                    int offsetX = (ICON_SIZE - newWidth) / 2;
-                    int offsetY = (ICON_SIZE - newHeight) / 2;
-                    ImageDraw(&paddedImg, img,
-                              (Rectangle){0, 0, (float)newWidth, (float)newHeight},
-                              (Rectangle){(float)offsetX, (float)offsetY, (float)newWidth, (float)newHeight},
-                              WHITE);
-                    UnloadImage(img);
-                    img = paddedImg;
-                }
+        if (!watchedDirs.empty())
+        {
+            thread = std::thread(&ApplicationWatcher::Run, this);
+        }
+    }
 
-                tex = LoadTextureFromImage(img);
-                UnloadImage(img);
+    ~ApplicationWatcher()
+    {
+        if (thread.joinable())
+        {
+            uint64_t one = 1;
+            if (write(stopFd, &one, sizeof(one)) < 0)
+                std::cerr << "Failed to stop application watcher" << std::endl;
+            thread.join();
+        }
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+        if (stopFd >= 0)
+            close(stopFd);
+    }
 
-                // Set texture filtering for better quality
-                SetTextureFilter(tex, TEXTURE_FILTER_BILINEAR);
+    ApplicationWatcher(const ApplicationWatcher &) = delete;
+    ApplicationWatcher &operator=(const ApplicationWatcher &) = delete;
 
-                return true; // Successfully loaded
-            }
-            else
-            {
-                return false; // Failed to load image
-            }
+    // Returns true when events were lost and the list has to be reloaded
+    bool TakeChanges(std::vector<Change> &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Change &change : changes)
+        {
+            out.push_back(std::move(change));
         }
+        changes.clear();
+
+        bool lost = overflowed;
+        overflowed = false;
+        return lost;
     }
 };
 
@@ -496,6 +2309,27 @@ class AppLauncher
 {
 private:
     std::vector<std::unique_ptr<AppEntry>> apps;
+    std::unordered_map<std::string, AppEntry *> appsByFile; // By desktopFile, to match results and changes
+    DesktopIndex desktopIndex;
+    IconAtlas atlas;
+    LabelAtlas labels;
+    std::unique_ptr<AsyncIconLoader> iconLoader; // Kept with its cache mapped for live additions
+    bool iconsLoading = false;
+    std::chrono::steady_clock::time_point iconLoadStart;
+    bool reportIconPass = false;
+    std::unique_ptr<ApplicationWatcher> watcher;
+
+    // Per-frame layout of the tiles being drawn, kept to reuse its storage
+    struct TileLayout
+    {
+        int index;
+        float drawX;
+        float drawY;
+        float iconX;
+        float iconY;
+        float scaledSize;
+    };
+    std::vector<TileLayout> tiles;
     int selectedIndex;
     int hoveredIndex;
     float scrollY;
@@ -517,84 +2351,318 @@ private:
     float animTimer;
     float fadeAlpha;
     int launchingAppIndex;
+    int launchFirst = 0; // Tiles taking part in the launch animation
+    int launchLast = 0;
+    int fadeInTiles = 0; // Tiles staggered by the current fade-in
+    float frameTime = 0; // Seconds since the last loop iteration, drawn or not
+    bool sceneChanged = true; // Something on screen differs from the last frame drawn
     std::string pendingLaunchCommand;
 
     void LoadApplicationsFromDirectory(const fs::path &dir)
     {
-        if (!fs::exists(dir) || !fs::is_directory(dir))
+        desktopIndex.Scan(dir, apps);
+    }
+
+    static bool CompareNames(const std::string &a, const std::string &b)
+    {
+        return std::lexicographical_compare(
+            a.begin(), a.end(),
+            b.begin(), b.end(),
+            [](char c1, char c2)
+            { return std::tolower(c1) < std::tolower(c2); });
+    }
+
+    static bool CompareApps(const std::unique_ptr<AppEntry> &a, const std::unique_ptr<AppEntry> &b)
+    {
+        return CompareNames(a->name, b->name);
+    }
+
+    // The app with this desktop file, or nullptr
+    AppEntry *FindApp(const std::string &desktopFile)
+    {
+        auto it = appsByFile.find(desktopFile);
+        return it != appsByFile.end() ? it->second : nullptr;
+    }
+
+    // Binary search by name, since apps stays sorted
+    int IndexOf(const AppEntry *app)
+    {
+        auto it = std::lower_bound(apps.begin(), apps.end(), app->name,
+                                   [](const std::unique_ptr<AppEntry> &entry, const std::string &name)
+                                   { return CompareNames(entry->name, name); });
+        for (; it != apps.end() && !CompareNames(app->name, (*it)->name); ++it)
+        {
+            if (it->get() == app)
+                return it - apps.begin();
+        }
+        return -1;
+    }
+
+    void SortApplications()
+    {
+        std::sort(apps.begin(), apps.end(), CompareApps);
+    }
+
+    void LoadIcons()
+    {
+        std::cout << "Loading icons for " << apps.size() << " applications..." << std::endl;
+        iconLoadStart = std::chrono::steady_clock::now();
+
+        atlas.Reserve(apps.size());
+        if (!iconLoader)
+        {
+            iconLoader = std::make_unique<AsyncIconLoader>();
+        }
+        iconsLoading = true;
+        reportIconPass = true;
+
+        // Grid order, so the first screen fills in first
+        std::vector<AppEntry *> batch;
+        for (const auto &app : apps)
+        {
+            batch.push_back(app.get());
+        }
+        iconLoader->Enqueue(batch, true);
+    }
+
+    // Icons for apps added or changed since the last pass, by desktop file
+    void RequestIcons(const std::set<std::string> &desktopFiles)
+    {
+        std::vector<AppEntry *> batch;
+        for (const std::string &desktopFile : desktopFiles)
+        {
+            // Skips apps removed again in the same round of changes
+            AppEntry *app = FindApp(desktopFile);
+            if (app && !app->hasIcon)
+                batch.push_back(app);
+        }
+        if (batch.empty())
+            return;
+
+        if (!iconLoader)
+        {
+            iconLoader = std::make_unique<AsyncIconLoader>();
+        }
+        // They usually bring new icons; one theme rescan covers the batch
+        IconLoader::InvalidateIndex();
+        iconsLoading = true;
+        iconLoader->Enqueue(batch, false); // Keeps the rest of the cache
+    }
+
+    // Moves finished icons into the atlas until this frame's budget is spent
+    void UploadIcons()
+    {
+        if (!iconsLoading)
             return;
 
-        for (const auto &entry : fs::directory_iterator(dir))
+        double start = GetTime();
+        AsyncIconLoader::Result result;
+        while (GetTime() - start < ICON_UPLOAD_BUDGET && iconLoader->TakeResult(result))
         {
-            if (entry.path().extension() == ".desktop")
+            sceneChanged = true;
+
+            // The app may have been removed, or given another icon, meanwhile
+            AppEntry *app = FindApp(result.desktopFile);
+            if (app == result.app && app->icon == result.icon && !app->hasIcon)
             {
-                auto app = DesktopFileParser::ParseFile(entry.path());
-                if (app)
+                if (result.ok)
+                {
+                    atlas.Add(result.pixels, app->iconAtlas, app->iconRect);
+                    app->hasIcon = true;
+                }
+                else
                 {
-                    apps.push_back(std::move(app));
+                    // Only apps with a usable icon are shown
+                    RemoveApp(IndexOf(app));
                 }
             }
+            AsyncIconLoader::Release(result);
+        }
+
+        if (iconLoader->Finished())
+        {
+            iconsLoading = false;
+            CompactLabels(); // Apps dropped for lack of an icon leave holes
+            if (reportIconPass)
+            {
+                reportIconPass = false;
+                std::cout << "Packed icons into " << atlas.PageCount() << " atlas pages, labels into "
+                          << labels.PageCount() << std::endl;
+
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - iconLoadStart).count();
+                std::cout << "After filtering, " << apps.size() << " applications have valid icons (" << ms << " ms)" << std::endl;
+            }
         }
     }
 
-    void SortApplications()
+    void RemoveApp(int index)
     {
-        std::sort(apps.begin(), apps.end(),
-                  [](const std::unique_ptr<AppEntry> &a, const std::unique_ptr<AppEntry> &b)
-                  {
-                      return std::lexicographical_compare(
-                          a->name.begin(), a->name.end(),
-                          b->name.begin(), b->name.end(),
-                          [](char c1, char c2)
-                          { return std::tolower(c1) < std::tolower(c2); });
-                  });
+        std::unique_ptr<AppEntry> app = TakeApp(index);
+        if (app->hasIcon)
+        {
+            atlas.Release(app->iconAtlas, app->iconRect);
+        }
+        labels.Release(*app);
     }
 
-    void LoadIcons()
+    // Repacks the label atlas once removals have left it mostly holes
+    void CompactLabels()
     {
-        std::cout << "Loading icons for " << apps.size() << " applications..." << std::endl;
+        if (labels.Fragmented())
+        {
+            labels.Rebuild(apps, font);
+        }
+    }
+
+    std::unique_ptr<AppEntry> TakeApp(int index)
+    {
+        std::unique_ptr<AppEntry> app = std::move(apps[index]);
+        apps.erase(apps.begin() + index);
+        appsByFile.erase(app->desktopFile);
+
+        // Keep the selection on the same app
+        if (selectedIndex > index || selectedIndex >= (int)apps.size())
+        {
+            selectedIndex--;
+        }
+        if (launchingAppIndex > index)
+        {
+            launchingAppIndex--;
+        }
+        if (apps.empty())
+        {
+            selectedIndex = -1;
+        }
+        else if (selectedIndex < 0)
+        {
+            selectedIndex = 0;
+        }
+        hoveredIndex = -1;
+        UpdateMaxScroll();
+        return app;
+    }
+
+    // Inserts at the sorted position and returns the new index
+    int InsertApp(std::unique_ptr<AppEntry> app)
+    {
+        int index = std::upper_bound(apps.begin(), apps.end(), app, CompareApps) - apps.begin();
+        appsByFile[app->desktopFile] = app.get();
+        apps.insert(apps.begin() + index, std::move(app));
+
+        // Keep the selection on the same app
+        if (selectedIndex >= index || selectedIndex < 0)
+        {
+            selectedIndex = std::max(selectedIndex + 1, 0);
+        }
+        if (launchingAppIndex >= index)
+        {
+            launchingAppIndex++;
+        }
+        hoveredIndex = -1;
+        UpdateMaxScroll();
+        return index;
+    }
+
+    // Applies what the watcher saw since the last frame, without a reload
+    void ApplyAppChanges()
+    {
+        if (!watcher)
+            return;
+
+        std::vector<ApplicationWatcher::Change> changes;
+        if (watcher->TakeChanges(changes))
+        {
+            std::cout << "Application watcher lost events, reloading" << std::endl;
+            LoadApplications();
+            sceneChanged = true;
+            return;
+        }
+        if (!changes.empty())
+        {
+            sceneChanged = true;
+        }
+
+        std::set<std::string> needIcons;
+        for (ApplicationWatcher::Change &change : changes)
+        {
+            AppEntry *existing = FindApp(change.desktopFile);
+
+            if (!change.entry)
+            {
+                if (existing)
+                {
+                    std::cout << "Removed application: " << existing->name << std::endl;
+                    RemoveApp(IndexOf(existing));
+                }
+                continue;
+            }
+
+            if (!existing)
+            {
+                // New tiles fade in on their own, see UpdateAnimations
+                std::cout << "Added application: " << change.entry->name << std::endl;
+                AppEntry *app = change.entry.get();
+                labels.Add(*app, font);
+                InsertApp(std::move(change.entry));
+                needIcons.insert(change.desktopFile);
+                continue;
+            }
+
+            std::cout << "Updated application: " << change.entry->name << std::endl;
+            int index = IndexOf(existing);
+            bool wasSelected = index == selectedIndex;
+            std::unique_ptr<AppEntry> app = TakeApp(index);
+            if (app->name != change.entry->name)
+            {
+                labels.Release(*app);
+                app->name = change.entry->name;
+                labels.Add(*app, font);
+            }
+            app->exec = change.entry->exec;
+            if (app->icon != change.entry->icon)
+            {
+                if (app->hasIcon)
+                {
+                    atlas.Release(app->iconAtlas, app->iconRect);
+                    app->hasIcon = false;
+                }
+                app->icon = change.entry->icon;
+                needIcons.insert(change.desktopFile);
+            }
 
-        // Use erase-remove idiom to filter out apps without valid icons
-        apps.erase(
-            std::remove_if(apps.begin(), apps.end(),
-                           [](std::unique_ptr<AppEntry> &app)
-                           {
-                               std::string iconPath = IconLoader::FindIcon(app->icon);
-
-                               if (iconPath.empty())
-                               {
-                                   std::cout << "No icon found for: " << app->name << " (icon: " << app->icon << ")" << std::endl;
-                                   return true; // Remove this app
-                               }
-
-                               // Try to load the texture
-                               bool success = IconLoader::TryLoadIconTexture(iconPath, app->texture);
-                               if (success)
-                               {
-                                   app->hasTexture = true;
-                                   std::cout << "Successfully loaded icon for: " << app->name << std::endl;
-                                   return false; // Keep this app
-                               }
-                               else
-                               {
-                                   std::cout << "Failed to load icon texture for: " << app->name << " (path: " << iconPath << ")" << std::endl;
-                                   return true; // Remove this app
-                               }
-                           }),
-            apps.end());
-
-        std::cout << "After filtering, " << apps.size() << " applications have valid icons" << std::endl;
+            index = InsertApp(std::move(app));
+            if (wasSelected)
+            {
+                selectedIndex = index;
+            }
+        }
+        RequestIcons(needIcons);
+        CompactLabels();
     }
 
     void InitializeAnimations()
     {
-        // Set up staggered animation delays for Windows Phone effect
+        // Set up staggered animation delays for Windows Phone effect, on the
+        // tiles that can be seen; the rest start out settled
+        int first, last;
+        GetVisibleRange(first, last);
         for (int i = 0; i < (int)apps.size(); i++)
         {
-            apps[i]->animDelay = i * TILE_STAGGER_DELAY;
-            apps[i]->animProgress = 0.0f;
-            apps[i]->opacity = 0.0f;
+            if (i >= first && i < last)
+            {
+                apps[i]->animDelay = (i - first) * TILE_STAGGER_DELAY;
+                apps[i]->animProgress = 0.0f;
+                apps[i]->opacity = 0.0f;
+            }
+            else
+            {
+                apps[i]->animProgress = 1.0f;
+                apps[i]->opacity = 1.0f;
+                apps[i]->scale = 1.0f;
+                apps[i]->animOffset = {0, 0};
+            }
         }
+        fadeInTiles = last - first;
     }
 
     int CalculateGridColumns(int windowWidth) const
@@ -611,6 +2679,30 @@ private:
         maxScrollY = std::max(0.0f, contentHeight - windowHeight);
     }
 
+    // Tiles in rows that overlap the window, plus a row either side for the
+    // fade-in slide; last is one past the end
+    void GetVisibleRange(int &first, int &last) const
+    {
+        int windowHeight = GetScreenHeight();
+        int firstRow = (int)std::floor((scrollY - TOP_MARGIN) / CELL_HEIGHT) - 1;
+        int lastRow = (int)std::floor((scrollY - TOP_MARGIN + windowHeight) / CELL_HEIGHT) + 1;
+        first = std::clamp(firstRow * currentGridCols, 0, (int)apps.size());
+        last = std::clamp((lastRow + 1) * currentGridCols, first, (int)apps.size());
+    }
+
+    // The tile under a point, or -1; the inverse of GetCellRect
+    int GetIndexAt(Vector2 point) const
+    {
+        float gridWidth = currentGridCols * CELL_WIDTH;
+        float gridX = point.x - (GetScreenWidth() - gridWidth) / 2;
+        float gridY = point.y + scrollY - TOP_MARGIN;
+        if (gridX < 0 || gridX >= gridWidth || gridY < 0)
+            return -1;
+
+        int index = (int)(gridY / CELL_HEIGHT) * currentGridCols + (int)(gridX / CELL_WIDTH);
+        return index < (int)apps.size() ? index : -1;
+    }
+
     Rectangle GetCellRect(int index) const
     {
         int windowWidth = GetScreenWidth();
@@ -637,8 +2729,10 @@ private:
             launchingAppIndex = index;
             pendingLaunchCommand = apps[index]->exec + " &";
 
-            // Set initial positions for launch animation
-            for (int i = 0; i < (int)apps.size(); i++)
+            // Set initial positions for launch animation; only the tiles on
+            // screen take part, the others would fly off further out
+            GetVisibleRange(launchFirst, launchLast);
+            for (int i = launchFirst; i < launchLast; i++)
             {
                 Rectangle rect = GetCellRect(i);
                 apps[i]->animOffset.x = rect.x + rect.width / 2;
@@ -717,21 +2811,33 @@ public:
 
     void LoadApplications()
     {
+        if (iconLoader)
+        {
+            iconLoader->Cancel();
+        }
+        iconsLoading = false;
         apps.clear();
+        appsByFile.clear();
+        atlas.Clear();
+        labels.Clear();
+        auto start = std::chrono::steady_clock::now();
 
-        // Load from standard directories
-        LoadApplicationsFromDirectory("/usr/share/applications");
-        LoadApplicationsFromDirectory("/usr/local/share/applications");
-
-        // Load from user directory
-        std::string home = getenv("HOME") ? getenv("HOME") : "";
-        if (!home.empty())
+        for (const std::string &dir : GetApplicationDirectories())
         {
-            LoadApplicationsFromDirectory(home + "/.local/share/applications");
+            LoadApplicationsFromDirectory(dir);
         }
 
+        desktopIndex.Save();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loaded " << apps.size() << " desktop entries in " << ms << " ms" << std::endl;
+
         SortApplications();
-        LoadIcons(); // This now filters out apps without icons
+        for (const auto &app : apps)
+        {
+            appsByFile[app->desktopFile] = app.get();
+        }
+        labels.Rebuild(apps, font);
+        LoadIcons(); // Apps without a usable icon drop out as results arrive
         InitializeAnimations();
         UpdateMaxScroll();
 
@@ -758,18 +2864,13 @@ public:
         CheckWindowResize();
 
         // Mouse input
-        Vector2 mousePos = GetMousePosition();
-        for (int i = 0; i < (int)apps.size(); i++)
+        int pointed = GetIndexAt(GetMousePosition());
+        if (pointed >= 0)
         {
-            Rectangle cellRect = GetCellRect(i);
-            if (CheckCollisionPointRec(mousePos, cellRect))
+            hoveredIndex = pointed;
+            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
             {
-                hoveredIndex = i;
-                if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
-                {
-                    LaunchApp(i);
-                }
-                break;
+                LaunchApp(pointed);
             }
         }
 
@@ -807,7 +2908,7 @@ public:
             float axisY = GetGamepadAxisMovement(0, GAMEPAD_AXIS_LEFT_Y);
 
             static float gamepadCooldown = 0;
-            gamepadCooldown -= GetFrameTime();
+            gamepadCooldown -= frameTime;
 
             if (gamepadCooldown <= 0)
             {
@@ -863,9 +2964,15 @@ public:
 
         // Smooth scroll
         scrollY += (targetScrollY - scrollY) * SMOOTH_SCROLL_FACTOR;
+        if (std::fabs(targetScrollY - scrollY) < 0.5f)
+        {
+            scrollY = targetScrollY;
+        }
 
-        // Update animations
-        for (int i = 0; i < (int)apps.size(); i++)
+        // Update animations of the tiles on screen
+        int first, last;
+        GetVisibleRange(first, last);
+        for (int i = first; i < last; i++)
         {
             if (i == selectedIndex || i == hoveredIndex)
             {
@@ -881,8 +2988,9 @@ public:
 
     void UpdateAnimations()
     {
-        float deltaTime = GetFrameTime();
+        float deltaTime = frameTime;
         animTimer += deltaTime;
+        int first, last;
 
         switch (animState)
         {
@@ -892,17 +3000,18 @@ public:
             if (fadeAlpha < 0)
                 fadeAlpha = 0;
 
-            // Update app animations
-            for (auto &app : apps)
+            // Update app animations; tiles off screen were settled up front
+            GetVisibleRange(first, last);
+            for (int i = first; i < last; i++)
             {
-                if (animTimer > app->animDelay)
+                if (animTimer > apps[i]->animDelay)
                 {
-                    app->UpdateFadeInAnimation(deltaTime);
+                    apps[i]->UpdateFadeInAnimation(deltaTime);
                 }
             }
 
             // Check if fade in is complete
-            if (animTimer > FADE_IN_DURATION + apps.size() * TILE_STAGGER_DELAY + TILE_ANIMATION_DURATION)
+            if (animTimer > FADE_IN_DURATION + fadeInTiles * TILE_STAGGER_DELAY + TILE_ANIMATION_DURATION)
             {
                 animState = ANIM_NORMAL;
                 fadeAlpha = 0;
@@ -922,7 +3031,8 @@ public:
                 launchRect.y + launchRect.height / 2};
 
             // Update each app's launch animation
-            for (int i = 0; i < (int)apps.size(); i++)
+            launchLast = std::min(launchLast, (int)apps.size());
+            for (int i = launchFirst; i < launchLast; i++)
             {
                 apps[i]->UpdateLaunchAnimation(progress, i, apps.size(), centerPoint);
             }
@@ -935,6 +3045,7 @@ public:
             {
                 system(pendingLaunchCommand.c_str());
                 pendingLaunchCommand.clear();
+                sceneChanged = true; // Draw the final, fully faded frame
             }
 
             // Handle restore animation
@@ -959,11 +3070,49 @@ public:
         break;
 
         case ANIM_NORMAL:
-            // Normal state, no special animations
+            // Tiles added by the watcher fade in on their own, once seen
+            GetVisibleRange(first, last);
+            for (int i = first; i < last; i++)
+            {
+                if (apps[i]->animProgress < 1.0f)
+                {
+                    apps[i]->UpdateFadeInAnimation(deltaTime);
+                }
+            }
             break;
         }
     }
 
+    // True while anything on screen is still moving or filling in
+    bool IsSceneActive()
+    {
+        if (iconsLoading || animState == ANIM_FADE_IN)
+            return true;
+        if (animState == ANIM_LAUNCHING)
+            return animTimer < LAUNCH_ANIMATION_DURATION;
+        if (scrollY != targetScrollY)
+            return true;
+
+        int first, last;
+        GetVisibleRange(first, last);
+        for (int i = first; i < last; i++)
+        {
+            if (apps[i]->scale != apps[i]->targetScale || apps[i]->animProgress < 1.0f)
+                return true;
+        }
+        return false;
+    }
+
+    // Sleeps instead of drawing a frame that would look the same, then picks
+    // up input. EnableEventWaiting would block with no timeout, which stalls
+    // gamepads (polled, not evented), the music stream and watcher updates.
+    void WaitForEvents(bool focused)
+    {
+        bool polling = focused || IsMusicStreamPlaying(music);
+        WaitTime(polling ? IDLE_POLL_INTERVAL : BACKGROUND_POLL_INTERVAL);
+        PollInputEvents();
+    }
+
     void Draw()
     {
         int windowWidth = GetScreenWidth();
@@ -987,19 +3136,29 @@ public:
         }
         else
         {
-            // Draw apps
-            for (int i = 0; i < (int)apps.size(); i++)
+            // Lay out the visible tiles first, then draw highlights, icons and
+            // labels in separate passes so consecutive draws share a texture
+            // and raylib can batch them
+            int first, last;
+            if (animState == ANIM_LAUNCHING)
+            {
+                first = launchFirst;
+                last = std::min(launchLast, (int)apps.size());
+            }
+            else
+            {
+                GetVisibleRange(first, last);
+            }
+
+            tiles.clear();
+            for (int i = first; i < last; i++)
             {
                 Rectangle cellRect = GetCellRect(i);
 
-                // Skip if outside visible area (only in normal state)
+                // Skip rows only partly in the visible range
                 if (animState == ANIM_NORMAL && (cellRect.y + CELL_HEIGHT < 0 || cellRect.y > windowHeight))
                     continue;
 
-                float scale = apps[i]->scale;
-                float opacity = apps[i]->opacity;
-                bool isSelected = (i == selectedIndex || i == hoveredIndex);
-
                 // Apply animation offsets
                 float drawX = cellRect.x;
                 float drawY = cellRect.y;
@@ -1014,41 +3173,80 @@ public:
                     drawY = apps[i]->animOffset.y - cellRect.height / 2;
                 }
 
-                // Draw selection highlight
-                if (isSelected && animState == ANIM_NORMAL)
+                TileLayout tile;
+                tile.index = i;
+                tile.drawX = drawX;
+                tile.drawY = drawY;
+                tile.iconX = drawX + cellRect.width / 2;
+                tile.iconY = drawY + CELL_HEIGHT / 2 - 20;
+                tile.scaledSize = ICON_SIZE * apps[i]->scale;
+                tiles.push_back(tile);
+            }
+
+            // Draw selection highlight
+            if (animState == ANIM_NORMAL)
+            {
+                for (const TileLayout &tile : tiles)
                 {
-                    Color highlightColor = {100, 150, 200, (unsigned char)(100 * opacity)}; // Light blue highlight
+                    if (tile.index != selectedIndex && tile.index != hoveredIndex)
+                        continue;
+
+                    Color highlightColor = {100, 150, 200, (unsigned char)(100 * apps[tile.index]->opacity)}; // Light blue highlight
                     DrawRectangleRounded(
-                        {drawX + 10, drawY + 10, cellRect.width - 20, cellRect.height - 20},
+                        {tile.drawX + 10, tile.drawY + 10, CELL_WIDTH - 20.0f, CELL_HEIGHT - 20.0f},
                         0.1f, 8, highlightColor);
                 }
+            }
 
-                // Draw icon with scaling
-                float iconX = drawX + cellRect.width / 2;
-                float iconY = drawY + CELL_HEIGHT / 2 - 20;
-                float scaledSize = ICON_SIZE * scale;
+            // Placeholders for icons still loading
+            for (const TileLayout &tile : tiles)
+            {
+                const AppEntry &app = *apps[tile.index];
+                if (!app.hasIcon)
+                {
+                    Color placeholderColor = {180, 180, 180, (unsigned char)(120 * app.opacity)};
+                    DrawRectangleRounded(
+                        {tile.iconX - tile.scaledSize / 2, tile.iconY - tile.scaledSize / 2, tile.scaledSize, tile.scaledSize},
+                        0.2f, 8, placeholderColor);
+                }
+            }
 
-                if (apps[i]->hasTexture)
+            // Draw icons with scaling, all from the shared atlas pages
+            for (const TileLayout &tile : tiles)
+            {
+                const AppEntry &app = *apps[tile.index];
+                if (app.hasIcon)
                 {
-                    Color tint = {255, 255, 255, (unsigned char)(255 * opacity)};
+                    Color tint = {255, 255, 255, (unsigned char)(255 * app.opacity)};
                     DrawTexturePro(
-                        apps[i]->texture,
-                        {0, 0, (float)apps[i]->texture.width, (float)apps[i]->texture.height},
-                        {iconX - scaledSize / 2, iconY - scaledSize / 2, scaledSize, scaledSize},
+                        app.iconAtlas, app.iconRect,
+                        {tile.iconX - tile.scaledSize / 2, tile.iconY - tile.scaledSize / 2, tile.scaledSize, tile.scaledSize},
                         {0, 0}, 0, tint);
                 }
+            }
+
+            // Draw app names, pre-rendered with their shadow. The labels hold
+            // coverage, so scaling the background by one minus it draws black
+            // text, and the tint fades it.
+            rlSetBlendFactors(RL_ZERO, RL_ONE_MINUS_SRC_COLOR, RL_FUNC_ADD);
+            BeginBlendMode(BLEND_CUSTOM);
+            for (const TileLayout &tile : tiles)
+            {
+                const AppEntry &app = *apps[tile.index];
+                if (!app.labelAtlas.id)
+                    continue;
 
-                // Draw app name
-                Vector2 textSize = MeasureTextEx(font, apps[i]->name.c_str(), 32, 1);
-                float textX = drawX + cellRect.width / 2 - textSize.x / 2;
-                float textY = iconY + scaledSize / 2 + 10;
+                // Whole pixels keep the label texels 1:1 with the screen
+                float width = app.labelRect.width;
+                float height = -app.labelRect.height;
+                float textX = std::floor(tile.drawX + CELL_WIDTH / 2.0f - (width - 1) / 2);
+                float textY = std::floor(tile.iconY + tile.scaledSize / 2 + 10);
 
-                // Draw text shadow
-                Color shadowColor = {50, 50, 50, (unsigned char)(32 * opacity)}; // Darker shadow
-                Color textColor = {0, 0, 0, (unsigned char)(255 * opacity)};      // Black text
-                DrawTextEx(font, apps[i]->name.c_str(), {textX + 1, textY + 1}, 32, 1, shadowColor);
-                DrawTextEx(font, apps[i]->name.c_str(), {textX, textY}, 32, 1, textColor);
+                unsigned char alpha = (unsigned char)(255 * app.opacity);
+                DrawTexturePro(app.labelAtlas, app.labelRect, {textX, textY, width, height},
+                               {0, 0}, 0, Color{alpha, alpha, alpha, 255});
             }
+            EndBlendMode();
         }
 
         // Draw UI elements only when not launching an app
@@ -1100,24 +3298,120 @@ public:
 
     void Run()
     {
+        // A fresh account has no user directory until the first per-user
+        // install creates it, and inotify can't watch what doesn't exist yet
+        std::string userDir = GetUserApplicationDirectory();
+        if (!userDir.empty())
+        {
+            std::error_code ec;
+            fs::create_directories(userDir, ec);
+            if (ec)
+                std::cerr << "Failed to create " << userDir << ": " << ec.message() << std::endl;
+        }
+
+        // Watch before listing, so a file written during the scan is not missed;
+        // one the scan also saw comes through as an unchanged update
+        watcher = std::make_unique<ApplicationWatcher>(GetApplicationDirectories());
         LoadApplications();
 
+        bool wasFocused = true;
+        double lastUpdate = GetTime();
         while (!WindowShouldClose())
         {
+            // Frame time of our own; raylib's only advances when a frame is drawn
+            double now = GetTime();
+            frameTime = (float)std::min(now - lastUpdate, (double)MAX_FRAME_TIME);
+            lastUpdate = now;
+
             if (music.stream.buffer != nullptr)
             {
                 UpdateMusicStream(music);
             }
 
+            ApplyAppChanges();
+            UploadIcons();
             UpdateAnimations();
+
+            int selected = selectedIndex;
+            int hovered = hoveredIndex;
+            int width = lastWindowWidth;
+            int height = lastWindowHeight;
             HandleInput();
-            Draw();
+            if (selected != selectedIndex || hovered != hoveredIndex || width != lastWindowWidth || height != lastWindowHeight)
+            {
+                sceneChanged = true;
+            }
+
+            // Nothing is drawn while another window has focus
+            bool focused = IsWindowFocused();
+            if (focused && !wasFocused)
+            {
+                sceneChanged = true;
+            }
+            wasFocused = focused;
+
+            if (focused && (sceneChanged || IsSceneActive()))
+            {
+                sceneChanged = false;
+                Draw();
+            }
+            else
+            {
+                WaitForEvents(focused);
+            }
         }
     }
 };
 
-int main()
+// Parses every .desktop file in the application directories (or in dir)
+// over and over for about a second and reports the rate
+int RunParseBenchmark(const char *dir)
+{
+    std::vector<std::string> dirs = dir ? std::vector<std::string>{dir} : GetApplicationDirectories();
+    std::vector<fs::path> files;
+    for (const std::string &d : dirs)
+    {
+        std::error_code ec;
+        for (fs::directory_iterator it(d, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+        {
+            if (it->path().extension() == ".desktop")
+                files.push_back(it->path());
+        }
+    }
+    if (files.empty())
+    {
+        std::cerr << "No .desktop files to parse" << std::endl;
+        return 1;
+    }
+
+    size_t parsed = 0;
+    size_t visible = 0;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while (seconds < 1.0)
+    {
+        for (const fs::path &file : files)
+        {
+            if (DesktopFileParser::ParseFile(file))
+                visible++;
+        }
+        parsed += files.size();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::cout << "Parsed " << parsed << " desktop files (" << files.size() << " distinct, "
+              << visible * files.size() / parsed << " shown) in " << seconds << " s: "
+              << (size_t)(parsed / seconds) << " files/sec" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--parse-bench")
+    {
+        return RunParseBenchmark(argc > 2 ? argv[2] : nullptr);
+    }
+
     // Initialize window
     SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT | FLAG_MSAA_4X_HINT);
     InitWindow(INITIAL_WINDOW_WIDTH, INITIAL_WINDOW_HEIGHT, "Dendy Launcher");
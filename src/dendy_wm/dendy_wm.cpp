@@ -12,6 +12,10 @@
 
 static bool another_wm_running = false;
 
+// How long a window asked to close gets to save its state (e.g. the emulator's
+// fast-resume suspend) before it is destroyed.
+static const int CLOSE_GRACE_MS = 750;
+
 static int x_error_handler(Display *dpy, XErrorEvent *ee)
 {
     if (ee->error_code == BadAccess)
@@ -126,8 +130,10 @@ private:
         XEvent ev;
         for (;;)
         {
-            // Check if we need to process the Super key timeout
-            if (super_key_pressed_)
+            destroy_expired_windows();
+
+            // Check if we need to process the Super key timeout or pending closes
+            if ((super_key_pressed_ || !pending_destroy_.empty()) && XPending(display_) == 0)
             {
                 // Use select with timeout to check for events
                 fd_set fds;
@@ -145,7 +151,7 @@ private:
                     auto now = std::chrono::steady_clock::now();
                     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - super_press_start_);
 
-                    if (duration.count() >= 2000)
+                    if (super_key_pressed_ && duration.count() >= 2000)
                     {
                         std::cout << "Super key held for 2 seconds, closing all windows except initial" << std::endl;
                         close_all_except_initial();
@@ -263,8 +269,8 @@ private:
 
             XSendEvent(display_, w, False, NoEventMask, &close_event);
 
-            // Also forcefully destroy the window
-            XDestroyWindow(display_, w);
+            // Forcefully destroy the window if it is still around after the grace period
+            pending_destroy_.push_back({w, std::chrono::steady_clock::now() + std::chrono::milliseconds(CLOSE_GRACE_MS)});
         }
 
         XFlush(display_);
@@ -333,8 +339,34 @@ private:
         std::cout << "Handled ConfigureRequest for window " << e.window << std::endl;
     }
 
+    // Destroys windows that ignored WM_DELETE_WINDOW for longer than the grace period
+    void destroy_expired_windows()
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = pending_destroy_.begin(); it != pending_destroy_.end();)
+        {
+            if (it->second > now)
+            {
+                ++it;
+                continue;
+            }
+            if (std::find(client_windows_.begin(), client_windows_.end(), it->first) != client_windows_.end())
+            {
+                std::cout << "Window " << it->first << " did not close in time, destroying it" << std::endl;
+                XDestroyWindow(display_, it->first);
+                XFlush(display_);
+            }
+            it = pending_destroy_.erase(it);
+        }
+    }
+
     void handle_window_destroyed(Window w)
     {
+        pending_destroy_.erase(std::remove_if(pending_destroy_.begin(), pending_destroy_.end(),
+                                              [w](const auto &pending)
+                                              { return pending.first == w; }),
+                               pending_destroy_.end());
+
         auto it = std::find(client_windows_.begin(), client_windows_.end(), w);
 
         if (it != client_windows_.end())
@@ -381,6 +413,7 @@ private:
     Window initial_window_;
     bool super_key_pressed_;
     std::chrono::steady_clock::time_point super_press_start_;
+    std::vector<std::pair<Window, std::chrono::steady_clock::time_point>> pending_destroy_;
 };
 
 // Main function